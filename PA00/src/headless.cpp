@@ -0,0 +1,181 @@
+#include "headless.h"
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#ifndef __APPLE__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+bool headless = false;
+
+#ifndef __APPLE__
+static EGLDisplay display = EGL_NO_DISPLAY;
+static EGLContext context = EGL_NO_CONTEXT;
+static EGLSurface surface = EGL_NO_SURFACE;
+#endif
+static GLuint fbo = 0;
+static GLuint colorBuffer = 0;
+static GLuint depthBuffer = 0;
+
+bool headlessInit()
+{
+#ifdef __APPLE__
+    fprintf(stderr, "[F] HEADLESS RENDERING NEEDS EGL\n");
+    return false;
+#else
+    // Prefer a surfaceless display, it needs no window system at all
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if( getPlatformDisplay )
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if( display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL) )
+    {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if( display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL) )
+        {
+            fprintf(stderr, "[F] NO EGL DISPLAY\n");
+            return false;
+        }
+    }
+
+    // Desktop GL, the shaders and text overlay need the compatibility profile
+    if( !eglBindAPI(EGL_OPENGL_API) )
+    {
+        fprintf(stderr, "[F] EGL HAS NO DESKTOP OPENGL\n");
+        return false;
+    }
+
+    EGLint attributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+                            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                            EGL_NONE };
+    EGLConfig config;
+    EGLint configs = 0;
+    eglChooseConfig(display, attributes, &config, 1, &configs);
+
+    context = eglCreateContext(display, configs ? config : (EGLConfig)0, EGL_NO_CONTEXT, NULL);
+    if( context == EGL_NO_CONTEXT )
+    {
+        fprintf(stderr, "[F] COULD NOT CREATE EGL CONTEXT\n");
+        return false;
+    }
+
+    // Surfaceless first, a 1x1 pbuffer if the driver wants a surface
+    // (we draw into our own framebuffer either way)
+    if( !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context) )
+    {
+        EGLint pbufferAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        if( configs )
+            surface = eglCreatePbufferSurface(display, config, pbufferAttributes);
+        if( surface == EGL_NO_SURFACE ||
+            !eglMakeCurrent(display, surface, surface, context) )
+        {
+            fprintf(stderr, "[F] COULD NOT MAKE EGL CONTEXT CURRENT\n");
+            return false;
+        }
+    }
+
+    headless = true;
+    return true;
+#endif
+}
+
+bool glewStatusOk(GLenum status)
+{
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    if( headless && status == GLEW_ERROR_NO_GLX_DISPLAY )
+        return true;
+#endif
+    return status == GLEW_OK;
+}
+
+//Offscreen color and depth buffers standing in for the window
+static bool createFramebuffer(int width, int height)
+{
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+    return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+
+void headlessRun(int width, int height, int frames,
+                 void (*update)(), void (*render)())
+{
+    if( !createFramebuffer(width, height) )
+    {
+        fprintf(stderr, "[F] OFFSCREEN FRAMEBUFFER INCOMPLETE\n");
+        return;
+    }
+    glViewport(0, 0, width, height);
+
+    std::vector<float> frameTimes;
+    frameTimes.reserve(frames);
+    std::chrono::time_point<std::chrono::high_resolution_clock> start, frameStart, frameEnd;
+
+    start = std::chrono::high_resolution_clock::now();
+    for( int i = 0; i < frames; i++ )
+    {
+        frameStart = std::chrono::high_resolution_clock::now();
+        update();
+        render();
+        frameEnd = std::chrono::high_resolution_clock::now();
+        frameTimes.push_back(std::chrono::duration_cast< std::chrono::duration<float, std::milli> >(frameEnd - frameStart).count());
+    }
+    float total = std::chrono::duration_cast< std::chrono::duration<float> >(frameEnd - start).count();
+
+    if( frameTimes.empty() )
+        return;
+    std::vector<float> sorted(frameTimes);
+    std::sort(sorted.begin(), sorted.end());
+    float sum = 0;
+    for( unsigned int i = 0; i < sorted.size(); i++ )
+        sum += sorted[i];
+
+    printf("%d frames in %.3f s (%.1f fps)\n", frames, total, frames / total);
+    printf("frame ms: min %.3f  avg %.3f  p50 %.3f  p95 %.3f  p99 %.3f  max %.3f\n",
+           sorted.front(), sum / sorted.size(),
+           sorted[sorted.size() * 50 / 100], sorted[sorted.size() * 95 / 100],
+           sorted[sorted.size() * 99 / 100], sorted.back());
+}
+
+void headlessSwapBuffers()
+{
+    //nothing to present, but the frame time should include drawing it
+    glFinish();
+}
+
+void headlessCleanUp()
+{
+    if( fbo )
+    {
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteRenderbuffers(1, &colorBuffer);
+        glDeleteRenderbuffers(1, &depthBuffer);
+        fbo = 0;
+    }
+#ifndef __APPLE__
+    if( display != EGL_NO_DISPLAY )
+    {
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if( surface != EGL_NO_SURFACE )
+            eglDestroySurface(display, surface);
+        if( context != EGL_NO_CONTEXT )
+            eglDestroyContext(display, context);
+        eglTerminate(display);
+        display = EGL_NO_DISPLAY;
+    }
+#endif
+    headless = false;
+}
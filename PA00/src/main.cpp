@@ -1,6 +1,9 @@
 #include <GL/glew.h> // glew must be included before the main gl libs
 #include <GL/glut.h> // doing otherwise causes compiler shouting
 #include <iostream>
+#include <string.h>
+#include <stdlib.h>
+#include "headless.h"
 
 //--Data types
 //This object will define the attributes of a vertex(position, color, etc...)
@@ -32,17 +35,42 @@ void cleanUp();
 
 int main(int argc, char **argv)
 {
-    // Initialize glut
-    glutInit(&argc, argv);
-    glutInitDisplayMode(GLUT_DOUBLE | GLUT_DEPTH);
-    glutInitWindowSize(w, h);
-    // Name and create the Window
-    glutCreateWindow("Pass Through Shader Test");
+    // --headless draws offscreen instead of opening a window and
+    // --frames is how many frames it draws before exiting
+    int frames = 100;
+    bool offscreen = false;
+    for( int i = 1; i < argc; i++ )
+    {
+        if( strcmp(argv[i], "--headless") == 0 )
+        {
+            offscreen = true;
+        }
+        else if( strcmp(argv[i], "--frames") == 0 && i + 1 < argc )
+        {
+            frames = atoi(argv[++i]);
+        }
+    }
+
+    if( offscreen )
+    {
+        // No window, render into an offscreen framebuffer instead
+        if( !headlessInit() )
+            return -1;
+    }
+    else
+    {
+        // Initialize glut
+        glutInit(&argc, argv);
+        glutInitDisplayMode(GLUT_DOUBLE | GLUT_DEPTH);
+        glutInitWindowSize(w, h);
+        // Name and create the Window
+        glutCreateWindow("Pass Through Shader Test");
+    }
 
     // Now that the window is created the GL context is fully set up
     // Because of that we can now initialize GLEW to prepare work with shaders
     GLenum status = glewInit();
-    if( status != GLEW_OK)
+    if( !glewStatusOk(status) )
     {
         std::cerr << "[F] GLEW NOT INITIALIZED: ";
         std::cerr << glewGetErrorString(status) << std::endl;
@@ -50,20 +78,28 @@ int main(int argc, char **argv)
     }
 
     // Set all of the callbacks to GLUT that we need
-    glutDisplayFunc(render);// Called when its time to display
-    glutReshapeFunc(reshape);// Called if the window is resized
-    glutIdleFunc(update);// Called if there is nothing else to do
-    glutKeyboardFunc(keyboard);// Called if there is keyboard input
+    // (a headless run calls update and render itself)
+    if( !headless )
+    {
+        glutDisplayFunc(render);// Called when its time to display
+        glutReshapeFunc(reshape);// Called if the window is resized
+        glutIdleFunc(update);// Called if there is nothing else to do
+        glutKeyboardFunc(keyboard);// Called if there is keyboard input
+    }
 
     // Initialize all of our resources(shaders, geometry)
     bool init = initialize();
     if(init)
     {
-        glutMainLoop();
+        if( headless )
+            headlessRun(w, h, frames, update, render);
+        else
+            glutMainLoop();
     }
 
     // Clean up after ourselves
     cleanUp();
+    headlessCleanUp();
     return 0;
 }
 
@@ -104,13 +140,17 @@ void render()
     glDisableVertexAttribArray(loc_color);
                            
     //swap the buffers
-    glutSwapBuffers();
+    if( headless )
+        headlessSwapBuffers();
+    else
+        glutSwapBuffers();
 }
 
 void update()
 {
     // Update the state of the scene
-    glutPostRedisplay();//call the display callback
+    if( !headless )
+        glutPostRedisplay();//call the display callback
 }
 
 void reshape(int n_w, int n_h)
@@ -0,0 +1,31 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <GL/glew.h> // glew must be included before the main gl libs
+
+//--Headless rendering
+// Runs the program without a window: the GL context comes from EGL
+// (surfaceless when Mesa offers it, otherwise a small pbuffer) and every
+// frame is drawn into an offscreen framebuffer. Mesa's llvmpipe driver
+// makes this work on machines with no display and no GPU.
+
+extern bool headless;// true once --headless has been given
+
+//Creates the offscreen context, call it in place of glutCreateWindow
+bool headlessInit();
+
+//Draws frames by calling update and render directly, then prints timing
+//stats. Call it in place of glutMainLoop once glew is initialized.
+void headlessRun(int width, int height, int frames,
+                 void (*update)(), void (*render)());
+
+//Stands in for glutSwapBuffers, waits for the frame to finish
+void headlessSwapBuffers();
+
+void headlessCleanUp();
+
+//glewInit looks for a GLX display once it has loaded the GL functions,
+//which fails on an EGL context even though nothing is missing
+bool glewStatusOk(GLenum status);
+
+#endif
@@ -1,11 +1,14 @@
 #include <GL/glew.h> // glew must be included before the main gl libs
 #include <GL/glut.h> // doing otherwise causes compiler shouting
 #include <iostream>
+#include <string.h>
+#include <stdlib.h>
 #include <chrono>
 #include <fstream>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp> //Makes passing matrices to shaders easier
+#include "headless.h"
 
 
 //--Data types
@@ -55,17 +58,42 @@ const char* loadShaderFromFile(const char* fileName);
 //--Main
 int main(int argc, char **argv)
 {
-    // Initialize glut
-    glutInit(&argc, argv);
-    glutInitDisplayMode(GLUT_DOUBLE | GLUT_DEPTH);
-    glutInitWindowSize(w, h);
-    // Name and create the Window
-    glutCreateWindow("Matrix Example");
+    // --headless draws offscreen instead of opening a window and
+    // --frames is how many frames it draws before exiting
+    int frames = 100;
+    bool offscreen = false;
+    for( int i = 1; i < argc; i++ )
+    {
+        if( strcmp(argv[i], "--headless") == 0 )
+        {
+            offscreen = true;
+        }
+        else if( strcmp(argv[i], "--frames") == 0 && i + 1 < argc )
+        {
+            frames = atoi(argv[++i]);
+        }
+    }
+
+    if( offscreen )
+    {
+        // No window, render into an offscreen framebuffer instead
+        if( !headlessInit() )
+            return -1;
+    }
+    else
+    {
+        // Initialize glut
+        glutInit(&argc, argv);
+        glutInitDisplayMode(GLUT_DOUBLE | GLUT_DEPTH);
+        glutInitWindowSize(w, h);
+        // Name and create the Window
+        glutCreateWindow("Matrix Example");
+    }
 
     // Now that the window is created the GL context is fully set up
     // Because of that we can now initialize GLEW to prepare work with shaders
     GLenum status = glewInit();
-    if( status != GLEW_OK)
+    if( !glewStatusOk(status) )
     {
         std::cerr << "[F] GLEW NOT INITIALIZED: ";
         std::cerr << glewGetErrorString(status) << std::endl;
@@ -73,21 +101,29 @@ int main(int argc, char **argv)
     }
 
     // Set all of the callbacks to GLUT that we need
-    glutDisplayFunc(render);// Called when its time to display
-    glutReshapeFunc(reshape);// Called if the window is resized
-    glutIdleFunc(update);// Called if there is nothing else to do
-    glutKeyboardFunc(keyboard);// Called if there is keyboard input
+    // (a headless run calls update and render itself)
+    if( !headless )
+    {
+        glutDisplayFunc(render);// Called when its time to display
+        glutReshapeFunc(reshape);// Called if the window is resized
+        glutIdleFunc(update);// Called if there is nothing else to do
+        glutKeyboardFunc(keyboard);// Called if there is keyboard input
+    }
 
     // Initialize all of our resources(shaders, geometry)
     bool init = initialize();
     if(init)
     {
         t1 = std::chrono::high_resolution_clock::now();
-        glutMainLoop();
+        if( headless )
+            headlessRun(w, h, frames, update, render);
+        else
+            glutMainLoop();
     }
 
     // Clean up after ourselves
     cleanUp();
+    headlessCleanUp();
     return 0;
 }
 
@@ -135,7 +171,10 @@ void render()
     glDisableVertexAttribArray(loc_color);
                            
     //swap the buffers
-    glutSwapBuffers();
+    if( headless )
+        headlessSwapBuffers();
+    else
+        glutSwapBuffers();
 }
 
 void update()
@@ -150,7 +189,8 @@ void update()
     model = glm::translate( glm::mat4(1.0f), glm::vec3(4.0 * sin(angle), 0.0, 4.0 * cos(angle)));
     model = glm::rotate(model, rotAngle, glm::vec3(0, 1, 0));
     // Update the state of the scene
-    glutPostRedisplay();//call the display callback
+    if( !headless )
+        glutPostRedisplay();//call the display callback
 }
 
 
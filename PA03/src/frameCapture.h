@@ -0,0 +1,36 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <GL/glew.h> // glew must be included before the main gl libs
+
+//--Frame capture
+// Records every frame without stalling on glReadPixels. Each frame is
+// read into the next of a ring of pixel pack buffers, which only queues a
+// copy on the GPU, and a fence goes in after it. Frames whose fence has
+// passed are handed to a writer thread in order, and the writer turns them
+// into a Y4M stream or numbered PPM files while the next frames draw. The
+// frame only waits when the GPU is a whole ring behind or the writer
+// cannot keep up with the disk.
+//
+// With GL_ARB_buffer_storage the buffers stay mapped, and the writer reads
+// them in place. Without it each one is mapped once its fence passes and
+// copied out for the writer.
+
+#define CAPTURE_SLOTS 4// frames in flight between the GPU and the disk
+
+//Starts recording width x height frames. A target ending in .y4m is one
+//YUV 4:2:0 stream at fps frames a second, anything else is a printf
+//pattern for PPM files with one integer conversion (frames/moons%05d.ppm).
+//Needs GL 3.2 (sync objects), false if it is missing, the pattern has
+//another conversion or the target cannot be written.
+bool captureStart(const char *target, int width, int height, float fps);
+
+//Call after the frame is drawn and before the swap. A frame of another
+//size than the capture is skipped.
+void captureFrame(int width, int height);
+
+//Writes out the frames still in flight and stops the writer, safe to call
+//more than once
+void captureStop();
+
+#endif
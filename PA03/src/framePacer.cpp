@@ -0,0 +1,198 @@
+#include "framePacer.h"
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <math.h>
+#ifndef __APPLE__
+#include <string.h>
+#include <GL/glx.h>
+#include <GL/glxext.h>
+#endif
+
+#define NS_PER_SECOND 1000000000LL
+
+static long long period = 0;// ns between frames, 0 for no pacing
+static long long next = 0;// CLOCK_MONOTONIC time the next frame is due
+static long long early = 0;// ns before next to wake, half a refresh with vsync
+static bool requested = false;
+
+//the one second window and the whole run, for the stats
+struct PacerWindow
+{
+    long long start;
+    long long cpuStart;
+    long long slept;
+    unsigned long frames;
+};
+static PacerWindow second, run;
+static PacerStats stats = {0.0f, 0.0f, 0.0f};
+
+static long long nanoseconds(clockid_t clock)
+{
+    struct timespec now;
+    clock_gettime(clock, &now);
+    return now.tv_sec * NS_PER_SECOND + now.tv_nsec;
+}
+
+static void windowStart(PacerWindow &window, long long now)
+{
+    window.start = now;
+    window.cpuStart = nanoseconds(CLOCK_PROCESS_CPUTIME_ID);
+    window.slept = 0;
+    window.frames = 0;
+}
+
+static PacerStats windowStats(const PacerWindow &window, long long now)
+{
+    PacerStats result = {0.0f, 0.0f, 0.0f};
+    double elapsed = (double)(now - window.start);
+    if( elapsed <= 0 )
+        return result;
+    result.fps = window.frames * NS_PER_SECOND / elapsed;
+    result.cpu = (nanoseconds(CLOCK_PROCESS_CPUTIME_ID) - window.cpuStart) * 100.0 / elapsed;
+    result.asleep = window.slept * 100.0 / elapsed;
+    return result;
+}
+
+void pacerInit(float fps)
+{
+    period = fps > 0 ? (long long)(NS_PER_SECOND / fps) : 0;
+    early = 0;
+    long long now = nanoseconds(CLOCK_MONOTONIC);
+    next = now;
+    windowStart(second, now);
+    windowStart(run, now);
+}
+
+void pacerWait()
+{
+    long long now = nanoseconds(CLOCK_MONOTONIC);
+    if( period > 0 )
+    {
+        if( now < next - early )
+        {
+            //an absolute deadline, a signal just sleeps again to the same one
+            struct timespec due;
+            due.tv_sec = (next - early) / NS_PER_SECOND;
+            due.tv_nsec = (next - early) % NS_PER_SECOND;
+            while( clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR )
+                ;
+            long long woke = nanoseconds(CLOCK_MONOTONIC);
+            second.slept += woke - now;
+            run.slept += woke - now;
+            now = woke;
+        }
+        else if( now - next > period )
+        {
+            //more than a frame late, vsync is slower than the target or the
+            //window was hidden: go on from here
+            next = now;
+        }
+        next += period;
+    }
+
+    second.frames++;
+    run.frames++;
+    if( now - second.start >= NS_PER_SECOND )
+    {
+        stats = windowStats(second, now);
+        windowStart(second, now);
+    }
+}
+
+void pacerRequestFrame()
+{
+    requested = true;
+}
+
+bool pacerTakeRequest()
+{
+    bool was = requested;
+    requested = false;
+    return was;
+}
+
+#ifndef __APPLE__
+//The swap interval, 0 when vsync is off or nothing says
+static int swapInterval(Display *display, GLXDrawable drawable, const char *extensions)
+{
+    if( strstr(extensions, "GLX_EXT_swap_control") )
+    {
+        unsigned int interval = 0;
+        glXQueryDrawable(display, drawable, GLX_SWAP_INTERVAL_EXT, &interval);
+        return (int)interval;
+    }
+    if( strstr(extensions, "GLX_MESA_swap_control") )
+    {
+        PFNGLXGETSWAPINTERVALMESAPROC getInterval = (PFNGLXGETSWAPINTERVALMESAPROC)
+            glXGetProcAddressARB((const GLubyte*)"glXGetSwapIntervalMESA");
+        if( getInterval )
+            return getInterval();
+    }
+    return 0;
+}
+
+//Refreshes a second of the display the window is on, 0 if unknown
+static double refreshRate(Display *display, GLXDrawable drawable, const char *extensions)
+{
+    if( !strstr(extensions, "GLX_OML_sync_control") )
+        return 0;
+    PFNGLXGETMSCRATEOMLPROC getRate = (PFNGLXGETMSCRATEOMLPROC)
+        glXGetProcAddressARB((const GLubyte*)"glXGetMscRateOML");
+    int32_t numerator = 0, denominator = 0;
+    if( !getRate || !getRate(display, drawable, &numerator, &denominator) || denominator == 0 )
+        return 0;
+    return (double)numerator / denominator;
+}
+#endif
+
+void pacerMatchDisplay()
+{
+#ifndef __APPLE__
+    Display *display = glXGetCurrentDisplay();
+    GLXDrawable drawable = glXGetCurrentDrawable();
+    if( !display || !drawable || period == 0 )
+        return;
+    const char *extensions = glXQueryExtensionsString(display, DefaultScreen(display));
+    if( !extensions )
+        return;
+    int interval = swapInterval(display, drawable, extensions);
+    if( interval <= 0 )
+        return;
+    double refresh = refreshRate(display, drawable, extensions);
+    if( refresh <= 0 )
+    {
+        printf("Vsync is on at an unknown refresh rate, pacing to the target as it is\n");
+        return;
+    }
+
+    //the swaps come every interval refreshes at the soonest
+    long long swapPeriod = (long long)(NS_PER_SECOND * interval / refresh);
+    long long swaps = (long long)floor((double)period / swapPeriod + 0.5);
+    if( swaps <= 1 )
+    {
+        //the swap alone holds the rate down, sleeping would only drift
+        period = 0;
+        printf("Vsync at %.2f Hz (interval %d) paces the frames\n", refresh, interval);
+        return;
+    }
+    period = swaps * swapPeriod;
+    early = (long long)(NS_PER_SECOND / refresh / 2);
+    printf("Vsync at %.2f Hz (interval %d), pacing to %.2f fps\n",
+           refresh, interval, (double)NS_PER_SECOND / period);
+#endif
+}
+
+const PacerStats& pacerStats()
+{
+    return stats;
+}
+
+void pacerReport()
+{
+    long long now = nanoseconds(CLOCK_MONOTONIC);
+    PacerStats total = windowStats(run, now);
+    printf("%lu frames in %.1f s: %.1f fps, CPU %.1f%% of a core, %.0f%% asleep\n",
+           run.frames, (now - run.start) / (double)NS_PER_SECOND,
+           total.fps, total.cpu, total.asleep);
+}
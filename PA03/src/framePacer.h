@@ -0,0 +1,47 @@
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+//--Frame pacing
+// Instead of drawing as fast as the idle callback can spin, every frame
+// waits for its slot at a target rate. The wait is a clock_nanosleep to
+// an absolute deadline, so the time the frame itself took is not slept
+// again. A frame whose slot has already come (the swap blocked on vsync or
+// the frame ran long) does not sleep at all, and one that fell more than a
+// frame behind starts the schedule over from now instead of rushing to
+// catch up. Achieved frame rate and CPU use are measured over each second.
+//
+// When the swap waits for vsync, the pacer needs to agree with the display
+// or the two clocks drift against each other. pacerMatchDisplay reads the
+// swap interval and the refresh rate of the GLX window. The period is then
+// a whole number of swaps, and each frame wakes half a refresh early so
+// its swap lands on the vertical blank it was meant for. A target at or
+// over the vsync rate leaves the pacing to the swap alone.
+
+//Rates and CPU use over the last second (and for pacerReport the whole run)
+struct PacerStats
+{
+    float fps;// frames actually drawn a second
+    float cpu;// CPU time of the whole process, percent of one core
+    float asleep;// percent of the time spent sleeping in pacerWait
+};
+
+//fps of 0 draws frames as fast as they come
+void pacerInit(float fps);
+
+//Matches the period to vsync on the current GLX window, if it is on. Call
+//after pacerInit, once the window exists.
+void pacerMatchDisplay();
+
+//Sleeps until the next frame is due, call once at the start of a frame
+void pacerWait();
+
+//On demand drawing: input asks for a frame, the idle callback takes it
+void pacerRequestFrame();
+bool pacerTakeRequest();
+
+const PacerStats& pacerStats();
+
+//Prints the rates over the whole run
+void pacerReport();
+
+#endif
@@ -0,0 +1,177 @@
+#include "frameStats.h"
+#include <stdio.h>
+#include <chrono>
+
+typedef std::chrono::high_resolution_clock Clock;
+
+//Timings of a frame whose GPU query may still be in flight
+struct FrameRecord
+{
+    unsigned long frame;
+    float stage[STAGE_COUNT];
+    float frameTime;
+    unsigned int visible;
+    unsigned int culled;
+    bool hasQuery;
+};
+
+//a few frames deep is enough for the GPU to catch up
+#define QUERY_RING 4
+
+static bool timerQueries = false;
+static GLuint queries[QUERY_RING];
+static FrameRecord records[QUERY_RING];
+static unsigned int oldest = 0;// oldest record not written out yet
+static unsigned int pending = 0;// records waiting on their query
+
+static FrameRecord current;
+static bool queryIssued = false;
+static unsigned long frameNumber = 0;
+static Clock::time_point stageStart[STAGE_COUNT];
+static Clock::time_point lastFrame;
+static bool haveLastFrame = false;
+
+static FrameTiming average;
+static FILE *csv = NULL;
+
+static float milliseconds(Clock::time_point from, Clock::time_point to)
+{
+    return std::chrono::duration_cast< std::chrono::duration<float, std::milli> >(to - from).count();
+}
+
+//exponential moving average, about the last 20 frames
+static void smooth(float &value, float sample)
+{
+    value = value == 0 ? sample : value + (sample - value) * 0.05f;
+}
+
+static void writeRecord(const FrameRecord &record, float gpu)
+{
+    if( gpu >= 0 )
+        smooth(average.gpu, gpu);
+    if( !csv )
+        return;
+    fprintf(csv, "%lu,%.4f,%.4f,%.4f,", record.frame,
+            record.stage[STAGE_UPDATE], record.stage[STAGE_RENDER], record.stage[STAGE_SWAP]);
+    if( gpu >= 0 )
+        fprintf(csv, "%.4f", gpu);
+    fprintf(csv, ",%.4f,%u,%u\n", record.frameTime, record.visible, record.culled);
+}
+
+//Writes out finished records in frame order, blocking only when asked to
+static void collect(bool wait)
+{
+    while( pending > 0 )
+    {
+        FrameRecord &record = records[oldest];
+        float gpu = -1;
+        if( record.hasQuery )
+        {
+            GLint available = 0;
+            glGetQueryObjectiv(queries[oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+            if( !available && !wait )
+                return;
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(queries[oldest], GL_QUERY_RESULT, &elapsed);
+            gpu = elapsed / 1.0e6f;
+        }
+        writeRecord(record, gpu);
+        oldest = (oldest + 1) % QUERY_RING;
+        pending--;
+    }
+}
+
+void frameStatsInit(const char *csvFileName)
+{
+    timerQueries = GLEW_ARB_timer_query || GLEW_VERSION_3_3;
+    if( timerQueries )
+        glGenQueries(QUERY_RING, queries);
+    average.gpu = timerQueries ? 0 : -1;
+
+    if( csvFileName )
+    {
+        csv = fopen(csvFileName, "w");
+        if( csv )
+            fprintf(csv, "frame,update_ms,render_ms,swap_ms,gpu_ms,frame_ms,visible,culled\n");
+        else
+            fprintf(stderr, "[W] COULD NOT OPEN %s\n", csvFileName);
+    }
+}
+
+void frameStatsBegin(FrameStage stage)
+{
+    stageStart[stage] = Clock::now();
+}
+
+void frameStatsEnd(FrameStage stage)
+{
+    current.stage[stage] = milliseconds(stageStart[stage], Clock::now());
+    smooth(average.stage[stage], current.stage[stage]);
+}
+
+void frameStatsGpuBegin()
+{
+    //if the GPU is so far behind that the ring is full, skip this frame's
+    //query rather than wait for it. The first frame is skipped too, it pays
+    //for shader compiles and some drivers return garbage for it.
+    queryIssued = timerQueries && pending < QUERY_RING && frameNumber > 0;
+    if( queryIssued )
+        glBeginQuery(GL_TIME_ELAPSED, queries[(oldest + pending) % QUERY_RING]);
+}
+
+void frameStatsGpuEnd()
+{
+    if( queryIssued )
+        glEndQuery(GL_TIME_ELAPSED);
+}
+
+void frameStatsCounts(unsigned int visible, unsigned int culled)
+{
+    current.visible = visible;
+    current.culled = culled;
+    average.visible = visible;
+    average.culled = culled;
+}
+
+void frameStatsEndFrame()
+{
+    Clock::time_point now = Clock::now();
+    current.frame = frameNumber++;
+    current.frameTime = haveLastFrame ? milliseconds(lastFrame, now) : 0;
+    if( haveLastFrame )
+        smooth(average.frame, current.frameTime);
+    lastFrame = now;
+    haveLastFrame = true;
+
+    if( queryIssued )
+    {
+        current.hasQuery = true;
+        records[(oldest + pending) % QUERY_RING] = current;
+        pending++;
+        queryIssued = false;
+    }
+    else
+    {
+        //nothing to wait for (rows can come out of order when the ring
+        //was full, the frame column says which is which)
+        current.hasQuery = false;
+        writeRecord(current, -1);
+    }
+    collect(false);
+}
+
+const FrameTiming& frameStatsAverage()
+{
+    return average;
+}
+
+void frameStatsCleanUp()
+{
+    collect(true);
+    if( timerQueries )
+        glDeleteQueries(QUERY_RING, queries);
+    timerQueries = false;
+    if( csv )
+        fclose(csv);
+    csv = NULL;
+}
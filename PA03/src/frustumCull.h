@@ -0,0 +1,27 @@
+#ifndef FRUSTUMCULL_H
+#define FRUSTUMCULL_H
+
+#include <stddef.h>
+#include <glm/glm.hpp>
+
+//--View frustum culling
+// The six planes come straight out of projection * view, so they are in
+// world space. Every object is one mesh under its own model matrix, and the
+// mesh's bounding sphere is moved into world space with it. The plane
+// tests run on four spheres at a time with SSE.
+
+//A point p is inside a plane when dot(plane, vec4(p, 1)) >= 0
+struct Frustum
+{
+    glm::vec4 planes[6];// left, right, bottom, top, near, far
+};
+
+void frustumFromMatrix(const glm::mat4 &viewProjection, Frustum &frustum);
+
+//Tests the sphere (center, radius) of a mesh under every model matrix.
+//The indices of the models that may be visible go into visible (room for
+//count of them), and the return value is how many there are.
+size_t cullSpheres(const Frustum &frustum, const glm::mat4 *models, size_t count,
+                   const glm::vec3 &center, float radius, unsigned int *visible);
+
+#endif
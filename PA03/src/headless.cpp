@@ -0,0 +1,344 @@
+#include "headless.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#ifndef __APPLE__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+bool headless = false;
+HeadlessChecks headlessChecks = { 0, NULL, 8, 0.5f, NULL, 10.0f };
+
+#ifndef __APPLE__
+static EGLDisplay display = EGL_NO_DISPLAY;
+static EGLContext context = EGL_NO_CONTEXT;
+static EGLSurface surface = EGL_NO_SURFACE;
+#endif
+static GLuint fbo = 0;
+static GLuint colorBuffer = 0;
+static GLuint depthBuffer = 0;
+
+bool headlessInit()
+{
+#ifdef __APPLE__
+    fprintf(stderr, "[F] HEADLESS RENDERING NEEDS EGL\n");
+    return false;
+#else
+    // Prefer a surfaceless display, it needs no window system at all
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if( getPlatformDisplay )
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if( display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL) )
+    {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if( display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL) )
+        {
+            fprintf(stderr, "[F] NO EGL DISPLAY\n");
+            return false;
+        }
+    }
+
+    // Desktop GL, the shaders and text overlay need the compatibility profile
+    if( !eglBindAPI(EGL_OPENGL_API) )
+    {
+        fprintf(stderr, "[F] EGL HAS NO DESKTOP OPENGL\n");
+        return false;
+    }
+
+    EGLint attributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+                            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                            EGL_NONE };
+    EGLConfig config;
+    EGLint configs = 0;
+    eglChooseConfig(display, attributes, &config, 1, &configs);
+
+    context = eglCreateContext(display, configs ? config : (EGLConfig)0, EGL_NO_CONTEXT, NULL);
+    if( context == EGL_NO_CONTEXT )
+    {
+        fprintf(stderr, "[F] COULD NOT CREATE EGL CONTEXT\n");
+        return false;
+    }
+
+    // Surfaceless first, a 1x1 pbuffer if the driver wants a surface
+    // (we draw into our own framebuffer either way)
+    if( !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context) )
+    {
+        EGLint pbufferAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        if( configs )
+            surface = eglCreatePbufferSurface(display, config, pbufferAttributes);
+        if( surface == EGL_NO_SURFACE ||
+            !eglMakeCurrent(display, surface, surface, context) )
+        {
+            fprintf(stderr, "[F] COULD NOT MAKE EGL CONTEXT CURRENT\n");
+            return false;
+        }
+    }
+
+    headless = true;
+    return true;
+#endif
+}
+
+bool headlessOption(int argc, char **argv, int &i)
+{
+    if( i + 1 >= argc )
+        return false;
+    if( strcmp(argv[i], "--warmup") == 0 )
+        headlessChecks.warmup = atoi(argv[++i]);
+    else if( strcmp(argv[i], "--golden") == 0 )
+        headlessChecks.goldenFile = argv[++i];
+    else if( strcmp(argv[i], "--tolerance") == 0 )
+        headlessChecks.tolerance = atoi(argv[++i]);
+    else if( strcmp(argv[i], "--max-mismatch") == 0 )
+        headlessChecks.maxMismatch = atof(argv[++i]);
+    else if( strcmp(argv[i], "--baseline") == 0 )
+        headlessChecks.baselineFile = argv[++i];
+    else if( strcmp(argv[i], "--slowdown") == 0 )
+        headlessChecks.slowdown = atof(argv[++i]);
+    else
+        return false;
+    return true;
+}
+
+bool glewStatusOk(GLenum status)
+{
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    if( headless && status == GLEW_ERROR_NO_GLX_DISPLAY )
+        return true;
+#endif
+    return status == GLEW_OK;
+}
+
+//Offscreen color and depth buffers standing in for the window
+static bool createFramebuffer(int width, int height)
+{
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+    return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+
+//--PPM files, 8 bit binary RGB, rows top down
+static bool writePPM(const char *fileName, int width, int height, const std::vector<unsigned char> &pixels)
+{
+    FILE *file = fopen(fileName, "wb");
+    if( !file )
+        return false;
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    fwrite(&pixels[0], 1, pixels.size(), file);
+    return fclose(file) == 0;
+}
+
+static bool readPPM(const char *fileName, int &width, int &height, std::vector<unsigned char> &pixels)
+{
+    FILE *file = fopen(fileName, "rb");
+    if( !file )
+        return false;
+    int maxValue = 0;
+    bool ok = fscanf(file, "P6 %d %d %d", &width, &height, &maxValue) == 3 &&
+              maxValue == 255 && width > 0 && height > 0 && fgetc(file) != EOF;
+    if( ok )
+    {
+        pixels.resize((size_t)width * height * 3);
+        ok = fread(&pixels[0], 1, pixels.size(), file) == pixels.size();
+    }
+    fclose(file);
+    return ok;
+}
+
+//The last frame against the golden image, true if they match
+static bool checkGolden(int width, int height)
+{
+    //GL rows run bottom up
+    std::vector<unsigned char> frame((size_t)width * height * 3), flipped(frame.size());
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &frame[0]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    size_t row = (size_t)width * 3;
+    for( int y = 0; y < height; y++ )
+        memcpy(&flipped[(height - 1 - y) * row], &frame[y * row], row);
+
+    const char *goldenFile = headlessChecks.goldenFile;
+    int goldenWidth, goldenHeight;
+    std::vector<unsigned char> golden;
+    if( !readPPM(goldenFile, goldenWidth, goldenHeight, golden) )
+    {
+        if( !writePPM(goldenFile, width, height, flipped) )
+        {
+            printf("image: could not write %s\n", goldenFile);
+            return false;
+        }
+        printf("image: wrote %s, later runs are compared with it\n", goldenFile);
+        return true;
+    }
+
+    //the frame that did not match is kept next to the golden one
+    std::string actualFile = std::string(goldenFile) + ".actual.ppm";
+    if( goldenWidth != width || goldenHeight != height )
+    {
+        printf("image: FAIL, %s is %dx%d and the frame %dx%d\n", goldenFile, goldenWidth, goldenHeight, width, height);
+        writePPM(actualFile.c_str(), width, height, flipped);
+        return false;
+    }
+    size_t mismatched = 0;
+    int largest = 0;
+    for( size_t p = 0; p < flipped.size(); p += 3 )
+    {
+        int difference = 0;
+        for( int c = 0; c < 3; c++ )
+            difference = std::max(difference, abs((int)flipped[p + c] - (int)golden[p + c]));
+        largest = std::max(largest, difference);
+        if( difference > headlessChecks.tolerance )
+            mismatched++;
+    }
+    float percent = mismatched * 100.0f / (width * height);
+    bool pass = percent <= headlessChecks.maxMismatch;
+    printf("image: %s, %.3f%% of pixels off by more than %d (largest %d, %.3f%% allowed)\n",
+           pass ? "ok" : "FAIL", percent, headlessChecks.tolerance, largest, headlessChecks.maxMismatch);
+    if( !pass )
+        writePPM(actualFile.c_str(), width, height, flipped);
+    return pass;
+}
+
+//The frame time percentiles against the baseline, true if p50 and p95
+//are no slower than allowed
+static bool checkBaseline(const float percentiles[3])
+{
+    static const char *names[3] = { "p50", "p95", "p99" };
+    const char *baselineFile = headlessChecks.baselineFile;
+    float baseline[3];
+    FILE *file = fopen(baselineFile, "r");
+    bool found = file && fscanf(file, "%f %f %f", &baseline[0], &baseline[1], &baseline[2]) == 3;
+    if( file )
+        fclose(file);
+    if( !found )
+    {
+        file = fopen(baselineFile, "w");
+        if( !file )
+        {
+            printf("time: could not write %s\n", baselineFile);
+            return false;
+        }
+        fprintf(file, "%.3f %.3f %.3f\n", percentiles[0], percentiles[1], percentiles[2]);
+        fclose(file);
+        printf("time: wrote %s, later runs are compared with it\n", baselineFile);
+        return true;
+    }
+
+    //p99 of a few hundred frames is a handful of frames, one stray
+    //scheduler hiccup moves it a lot, so it is shown but not held to
+    bool pass = true;
+    for( int k = 0; k < 3; k++ )
+    {
+        float change = baseline[k] > 0 ? (percentiles[k] / baseline[k] - 1.0f) * 100.0f : 0.0f;
+        bool slow = k < 2 && change > headlessChecks.slowdown;
+        printf("time: %s %.3f ms, baseline %.3f ms (%+.1f%%)%s\n", names[k], percentiles[k], baseline[k],
+               change, slow ? "  FAIL" : (k < 2 ? "" : "  (not checked)"));
+        if( slow )
+            pass = false;
+    }
+    return pass;
+}
+
+bool headlessRun(int width, int height, int frames,
+                 void (*update)(), void (*render)())
+{
+    if( !createFramebuffer(width, height) )
+    {
+        fprintf(stderr, "[F] OFFSCREEN FRAMEBUFFER INCOMPLETE\n");
+        return false;
+    }
+    glViewport(0, 0, width, height);
+
+    //warmup frames count towards nothing, shaders and caches settle in them
+    for( int i = 0; i < headlessChecks.warmup; i++ )
+    {
+        update();
+        render();
+    }
+
+    std::vector<float> frameTimes;
+    frameTimes.reserve(frames);
+    std::chrono::time_point<std::chrono::high_resolution_clock> start, frameStart, frameEnd;
+
+    start = std::chrono::high_resolution_clock::now();
+    for( int i = 0; i < frames; i++ )
+    {
+        frameStart = std::chrono::high_resolution_clock::now();
+        update();
+        render();
+        frameEnd = std::chrono::high_resolution_clock::now();
+        frameTimes.push_back(std::chrono::duration_cast< std::chrono::duration<float, std::milli> >(frameEnd - frameStart).count());
+    }
+    float total = std::chrono::duration_cast< std::chrono::duration<float> >(frameEnd - start).count();
+
+    if( frameTimes.empty() )
+        return true;
+    std::vector<float> sorted(frameTimes);
+    std::sort(sorted.begin(), sorted.end());
+    float sum = 0;
+    for( unsigned int i = 0; i < sorted.size(); i++ )
+        sum += sorted[i];
+    float percentiles[3] = { sorted[sorted.size() * 50 / 100], sorted[sorted.size() * 95 / 100],
+                             sorted[sorted.size() * 99 / 100] };
+
+    printf("%d frames in %.3f s (%.1f fps)\n", frames, total, frames / total);
+    printf("frame ms: min %.3f  avg %.3f  p50 %.3f  p95 %.3f  p99 %.3f  max %.3f\n",
+           sorted.front(), sum / sorted.size(),
+           percentiles[0], percentiles[1], percentiles[2], sorted.back());
+
+    //both checks always run, so one failing still reports the other
+    bool pass = true;
+    if( headlessChecks.goldenFile && !checkGolden(width, height) )
+        pass = false;
+    if( headlessChecks.baselineFile && !checkBaseline(percentiles) )
+        pass = false;
+    return pass;
+}
+
+void headlessSwapBuffers()
+{
+    //nothing to present, but the frame time should include drawing it
+    glFinish();
+}
+
+void headlessCleanUp()
+{
+    if( fbo )
+    {
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteRenderbuffers(1, &colorBuffer);
+        glDeleteRenderbuffers(1, &depthBuffer);
+        fbo = 0;
+    }
+#ifndef __APPLE__
+    if( display != EGL_NO_DISPLAY )
+    {
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if( surface != EGL_NO_SURFACE )
+            eglDestroySurface(display, surface);
+        if( context != EGL_NO_CONTEXT )
+            eglDestroyContext(display, context);
+        eglTerminate(display);
+        display = EGL_NO_DISPLAY;
+    }
+#endif
+    headless = false;
+}
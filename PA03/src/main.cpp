@@ -1,12 +1,30 @@
 #include <GL/glew.h> // glew must be included before the main gl libs
 #include <GL/glut.h> // doing otherwise causes compiler shouting
 #include <iostream>
+#include <string.h>
+#include <stdlib.h>
 #include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 #include <vector>
 #include <fstream>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp> //Makes passing matrices to shaders easier
+#include "headless.h"
+#include "frameStats.h"
+#include "programCache.h"
+#include "shaderReload.h"
+#include "streamRing.h"
+#include "textOverlay.h"
+#include "sceneGraph.h"
+#include "transformBatch.h"
+#include "threadPool.h"
+#include "tripleBuffer.h"
+#include "frustumCull.h"
+#include "framePacer.h"
+#include "frameCapture.h"
 
 
 //--Data types
@@ -17,54 +35,106 @@ struct Vertex
     GLfloat color[3];
 };
 
-//GLUT Fonts
-  void * glutFonts[7] = {
-  GLUT_BITMAP_9_BY_15,
-  GLUT_BITMAP_8_BY_13,
-  GLUT_BITMAP_TIMES_ROMAN_10,
-  GLUT_BITMAP_TIMES_ROMAN_24,
-  GLUT_BITMAP_HELVETICA_10,
-  GLUT_BITMAP_HELVETICA_12,
-  GLUT_BITMAP_HELVETICA_18 };
+//Where the linked shader program is kept between runs
+#define PROGRAM_CACHE_FILE "assets/shaders/program.bin"
 
 //--Evil Global variables
 //Just for this example!
 int w = 640, h = 480;// Window size
-int ROTATION_FLAG = 0;
-int SPIN_MOD = 1;
-int PLANET_MOD = 1;
-float SPEED_MOD = 3;
+bool SHOW_STATS = true;// timing overlay, toggled with h
+char *csvFileName = NULL;// per frame timings go here with --csv
+char *captureTarget = NULL;// every frame is recorded here with --capture
+//read by the simulation thread, so these are atomic
+std::atomic<int> ROTATION_FLAG(0);
+std::atomic<int> SPIN_MOD(1);
+std::atomic<int> PLANET_MOD(1);
+std::atomic<float> SPEED_MOD(3);
+std::atomic<bool> PAUSED(false);// p stops the scene where it is
+std::atomic<bool> windowVisible(true);// a hidden window neither draws nor steps
 GLuint program;// The GLSL program handle
 GLuint vbo_geometry;// VBO handle for our geometry
-
-//uniform locations
-GLint loc_mvpmat;// Location of the modelviewprojection matrix in the shader
+StreamRing frameRing;// this frame's mvp matrices, one per visible planet or moon
+bool instancing = false;// draw every model with one instanced call
+int planetCount = 1;// planet and moon pairs (--planets)
+int threadCount = 0;// update threads besides this one, 0 is one per core (--threads)
+float targetFps = 60;// frames a second the window is paced to, 0 for as fast as it goes (--fps)
+bool onDemand = false;// only draw when something changed (--on-demand)
+bool sceneSettled = true;// the last frame drew the newest snapshot as it is
 
 //attribute locations
 GLint loc_position;
 GLint loc_color;
+GLint loc_mvp;// a mat4 attribute, takes 4 locations starting here
 
-//Multiple models
-std::vector<glm::mat4> models;
+//The scene, for every planet: system -> planet -> spinning body
+//                                              -> moon
+//Nodes are added a level at a time, so the bodies and moons (the things
+//we draw) end up next to each other at the end of the world matrices
+//Only the simulation thread touches the scene once it is running
+SceneGraph scene;
+int firstModel = 0;// scene node of the first model matrix
+unsigned int modelCount = 0;
+std::vector<int> planetNodes;
+std::vector<int> bodyNodes;
+std::vector<int> moonNodes;
 
 //transform matrices
 glm::mat4 model;//obj->world each object should have its own model matrix
 glm::mat4 view;//world->eye
 glm::mat4 projection;//eye->clip
-glm::mat4 mvp;//premultiplied modelviewprojection
+glm::mat4 vp;//premultiplied viewprojection
+std::vector<glm::mat4> mvps;//premultiplied modelviewprojection for every visible model
+std::vector<unsigned int> visibleIndices;// models that survived culling
+std::vector<glm::mat4> visibleWorlds;// and their matrices, packed
+#define CUBE_RADIUS 1.7320508f// the cube's corners are sqrt(3) from its center
+
+//--Simulation thread
+//The scene steps at a fixed rate on its own thread and publishes a copy
+//of the model matrices after every step. Rendering draws a blend of the
+//two newest copies, so motion stays smooth whatever the frame rate is.
+#define SIM_RATE 60// steps per second
+struct Snapshot
+{
+    double time;// seconds since simStart this state belongs to
+    std::vector<glm::mat4> worlds;
+    Snapshot() : time(0) {}
+};
+TripleBuffer<Snapshot> snapshots;
+std::vector<glm::mat4> previousWorlds;// the snapshot before the current one
+double previousTime = 0;
+std::vector<glm::mat4> blendedWorlds;
+std::thread simThread;
+std::atomic<bool> simRunning(false);
+std::atomic<float> simStepTime(0);// ms the last step took
+std::chrono::high_resolution_clock::time_point simStart;
+double fixedStep = 0;// --fixed-dt, seconds every frame moves the clock on, 0 for real time
+double fixedClock = 0;// the clock when it is fixed
 
 //--GLUT Callbacks
 void render();
 void update();
+void idle();
+void visibility(int state);
 void reshape(int n_w, int n_h);
 void keyboard(unsigned char key, int x_pos, int y_pos);
 void keypressSpecial(int key, int x_pos, int y_pos);
 void mouse(int button, int state, int x, int y);
 void rotation_menu(int id);
+void requestFrame();
 
 //--Resource management
 bool initialize();
 void cleanUp();
+void bindAttributes(GLuint newProgram);
+bool bindProgram(GLuint newProgram);
+void reloadShaders();
+
+//--Simulation
+void simulate();
+void step(float dt);
+void publishSnapshot(double time);
+double simSeconds();
+void stopThreads();
 
 //--Random time things
 float getDT();
@@ -72,24 +142,98 @@ std::chrono::time_point<std::chrono::high_resolution_clock> t1,t2;
 
 //Shader Loader
 const char* loadShaderFromFile(const char* fileName);
-
-//Text display
-void glutPrintText(float x, float y, char* text, void * font, 
-                              float r, float g, float b, float a);
 //--Main
 int main(int argc, char **argv)
 {
-    // Initialize glut
-    glutInit(&argc, argv);
-    glutInitDisplayMode(GLUT_DOUBLE | GLUT_DEPTH);
-    glutInitWindowSize(w, h);
-    // Name and create the Window
-    glutCreateWindow("Moons Example");
+    // --headless draws offscreen instead of opening a window and
+    // --frames is how many frames it draws before exiting
+    // --planets sets how many planet and moon pairs there are
+    // --threads sets how many extra threads help with the update
+    // --fixed-dt moves the scene on by that many seconds every frame
+    // --golden, --baseline and the rest check a headless run (headless.h)
+    // --fps sets the frame rate the window is paced to, 0 is unpaced
+    // --on-demand only draws when the scene changed or there was input
+    // --capture records every frame to a .y4m file or numbered PPM files
+    // --size sets the window (or offscreen frame) size, WxH
+    int frames = 100;
+    bool offscreen = false;
+    for( int i = 1; i < argc; i++ )
+    {
+        if( strcmp(argv[i], "--headless") == 0 )
+        {
+            offscreen = true;
+        }
+        else if( strcmp(argv[i], "--frames") == 0 && i + 1 < argc )
+        {
+            frames = atoi(argv[++i]);
+        }
+        else if( strcmp(argv[i], "--csv") == 0 && i + 1 < argc )
+        {
+            csvFileName = argv[++i];
+        }
+        else if( strcmp(argv[i], "--planets") == 0 && i + 1 < argc )
+        {
+            planetCount = std::max(atoi(argv[++i]), 1);
+        }
+        else if( strcmp(argv[i], "--threads") == 0 && i + 1 < argc )
+        {
+            threadCount = std::max(atoi(argv[++i]), 0);
+        }
+        else if( strcmp(argv[i], "--fixed-dt") == 0 && i + 1 < argc )
+        {
+            fixedStep = std::max(atof(argv[++i]), 0.0);
+        }
+        else if( strcmp(argv[i], "--fps") == 0 && i + 1 < argc )
+        {
+            targetFps = std::max(atof(argv[++i]), 0.0);
+        }
+        else if( strcmp(argv[i], "--on-demand") == 0 )
+        {
+            onDemand = true;
+        }
+        else if( strcmp(argv[i], "--capture") == 0 && i + 1 < argc )
+        {
+            captureTarget = argv[++i];
+        }
+        else if( strcmp(argv[i], "--size") == 0 && i + 1 < argc )
+        {
+            if( sscanf(argv[++i], "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0 )
+            {
+                std::cerr << "[F] --size NEEDS WIDTHxHEIGHT" << std::endl;
+                return -1;
+            }
+        }
+        else if( headlessOption(argc, argv, i) )
+        {
+            // a scenario check, headlessOption took it
+        }
+    }
+
+    //the timing overlay is different every run, it is left out of frames
+    //compared with a golden image
+    if( headlessChecks.goldenFile )
+        SHOW_STATS = false;
+
+    if( offscreen )
+    {
+        // No window, render into an offscreen framebuffer instead
+        if( !headlessInit() )
+            return -1;
+    }
+    else
+    {
+        // Initialize glut
+        glutInit(&argc, argv);
+        glutInitDisplayMode(GLUT_DOUBLE | GLUT_DEPTH);
+        glutInitWindowSize(w, h);
+        // Name and create the Window
+        glutCreateWindow("Moons Example");
+    }
 
     // Now that the window is created the GL context is fully set up
     // Because of that we can now initialize GLEW to prepare work with shaders
     GLenum status = glewInit();
-    if( status != GLEW_OK)
+    if( !glewStatusOk(status) )
     {
         std::cerr << "[F] GLEW NOT INITIALIZED: ";
         std::cerr << glewGetErrorString(status) << std::endl;
@@ -97,37 +241,79 @@ int main(int argc, char **argv)
     }
 
     // Set all of the callbacks to GLUT that we need
-    glutDisplayFunc(render);// Called when its time to display
-    glutReshapeFunc(reshape);// Called if the window is resized
-    glutIdleFunc(update);// Called if there is nothing else to do
-    glutKeyboardFunc(keyboard);// Called if there is keyboard input
-    glutSpecialFunc(keypressSpecial);// Called if there is special keyboard input
-    glutMouseFunc(mouse); //Called on mouse click
+    // (a headless run calls update and render itself)
+    if( !headless )
+    {
+        glutDisplayFunc(render);// Called when its time to display
+        glutReshapeFunc(reshape);// Called if the window is resized
+        glutIdleFunc(idle);// Called if there is nothing else to do
+        glutVisibilityFunc(visibility);// Called when the window is hidden or shown
+        glutKeyboardFunc(keyboard);// Called if there is keyboard input
+        glutSpecialFunc(keypressSpecial);// Called if there is special keyboard input
+        glutMouseFunc(mouse); //Called on mouse click
     
-    //Add our right click menu
-    glutCreateMenu(rotation_menu);
-    glutAddMenuEntry("Start Rotation", 1);
-    glutAddMenuEntry("Stop Rotation", 2);
-    glutAddMenuEntry("Quit", 3);
-    glutAttachMenu(GLUT_RIGHT_BUTTON);
+        //Add our right click menu
+        glutCreateMenu(rotation_menu);
+        glutAddMenuEntry("Start Rotation", 1);
+        glutAddMenuEntry("Stop Rotation", 2);
+        glutAddMenuEntry("Quit", 3);
+        glutAttachMenu(GLUT_RIGHT_BUTTON);
+    }
 
     // Initialize all of our resources(shaders, geometry)
+    threadPoolStart(threadCount);
+    atexit(stopThreads);// the key and menu handlers exit() without cleanUp
     bool init = initialize();
+    bool passed = true;
     if(init)
     {
+        frameStatsInit(csvFileName);
+        //a headless run draws its frames as fast as it can
+        pacerInit(headless ? 0 : targetFps);
+        if( !headless )
+        {
+            pacerMatchDisplay();
+            atexit(pacerReport);
+        }
+        //frames are labelled with the rate the scene moves at
+        if( captureTarget )
+        {
+            float captureFps = fixedStep > 0 ? 1.0 / fixedStep : (targetFps > 0 ? targetFps : 60.0f);
+            if( captureStart(captureTarget, w, h, captureFps) )
+                atexit(captureStop);// the key and menu handlers exit() too
+            else
+                std::cout << "WARNING: Not capturing" << std::endl;
+        }
         t1 = std::chrono::high_resolution_clock::now();
-        glutMainLoop();
+        simStart = t1;
+        publishSnapshot(0.0);
+        //a fixed clock is stepped by update instead
+        if( fixedStep <= 0 )
+        {
+            simRunning = true;
+            simThread = std::thread(simulate);
+        }
+        if( headless )
+            passed = headlessRun(w, h, frames, update, render);
+        else
+            glutMainLoop();
     }
 
     // Clean up after ourselves
     cleanUp();
-    return 0;
+    headlessCleanUp();
+    return passed ? 0 : 1;
 }
 
 //--Implementations
 void render()
 {
     //--Render the scene
+    frameStatsBegin(STAGE_RENDER);
+    frameStatsGpuBegin();
+
+    //pick up edited shaders
+    reloadShaders();
 
     //clear the screen
     glClearColor(0.0, 0.0, 0.2, 1.0);
@@ -144,75 +330,336 @@ void render()
     {
       sprintf(buff, "Planet Direction: Clockwise\n"); 
     }
-    glutPrintText(-0.95f, 0.9f, buff, glutFonts[6], 1.0f, 1.0f, 1.0f, 0.0f);
+    textPrint(-0.95f, 0.9f, buff, TEXT_LARGE, 1.0f, 1.0f, 1.0f);
     
-    for (unsigned int i=0;i<models.size(); i++) 
-    {
-      
-      mvp = projection * view * models[i];
-
-      //enable the shader program
-      glUseProgram(program);
-
-      //upload the matrix to the shader
-      glUniformMatrix4fv(loc_mvpmat, 1, GL_FALSE, glm::value_ptr(mvp));
-
-      //set up the Vertex Buffer Object so it can be drawn
-      glEnableVertexAttribArray(loc_position);
-      glEnableVertexAttribArray(loc_color);
-      glBindBuffer(GL_ARRAY_BUFFER, vbo_geometry);
-      //set pointers into the vbo for each of the attributes(position and color)
-      glVertexAttribPointer( loc_position,//location of attribute
-                             3,//number of elements
-                             GL_FLOAT,//type
-                             GL_FALSE,//normalized?
-                             sizeof(Vertex),//stride
-                             0);//offset
-
-      glVertexAttribPointer( loc_color,
-                             3,
-                             GL_FLOAT,
-                             GL_FALSE,
-                             sizeof(Vertex),
-                             (void*)offsetof(Vertex,color));
-
-      glDrawArrays(GL_TRIANGLES, 0, 36);//mode, starting index, count
+    //Timing overlay
+    if( SHOW_STATS )
+    {
+      char stats[100];
+      const FrameTiming &timing = frameStatsAverage();
+      sprintf(stats, "Frame: %.2f ms (%.0f fps)", timing.frame,
+              timing.frame > 0 ? 1000.0f / timing.frame : 0.0f);
+      textPrint(-0.95f, 0.82f, stats, TEXT_SMALL, 1.0f, 1.0f, 0.0f);
+      sprintf(stats, "CPU update %.3f  render %.3f  swap %.3f ms",
+              timing.stage[STAGE_UPDATE], timing.stage[STAGE_RENDER], timing.stage[STAGE_SWAP]);
+      textPrint(-0.95f, 0.76f, stats, TEXT_SMALL, 1.0f, 1.0f, 0.0f);
+      if( timing.gpu < 0 )
+        sprintf(stats, "GPU n/a");
+      else
+        sprintf(stats, "GPU %.3f ms", timing.gpu);
+      textPrint(-0.95f, 0.70f, stats, TEXT_SMALL, 1.0f, 1.0f, 0.0f);
+      sprintf(stats, "Sim %.3f ms per step (%d Hz)", simStepTime.load(), SIM_RATE);
+      textPrint(-0.95f, 0.64f, stats, TEXT_SMALL, 1.0f, 1.0f, 0.0f);
+      sprintf(stats, "Visible %u  culled %u", timing.visible, timing.culled);
+      textPrint(-0.95f, 0.58f, stats, TEXT_SMALL, 1.0f, 1.0f, 0.0f);
+      if( !headless )
+      {
+        const PacerStats &paced = pacerStats();
+        if( targetFps > 0 )
+          sprintf(stats, "Paced to %.0f: %.1f fps  CPU %.0f%%  asleep %.0f%%",
+                  targetFps, paced.fps, paced.cpu, paced.asleep);
+        else
+          sprintf(stats, "Unpaced: %.1f fps  CPU %.0f%%", paced.fps, paced.cpu);
+        textPrint(-0.95f, 0.52f, stats, TEXT_SMALL, 1.0f, 1.0f, 0.0f);
+      }
+    }
+
+    //enable the shader program
+    glUseProgram(program);
+
+    //set up the Vertex Buffer Object so it can be drawn
+    glEnableVertexAttribArray(loc_position);
+    glEnableVertexAttribArray(loc_color);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_geometry);
+    //set pointers into the vbo for each of the attributes(position and color)
+    glVertexAttribPointer( loc_position,//location of attribute
+                           3,//number of elements
+                           GL_FLOAT,//type
+                           GL_FALSE,//normalized?
+                           sizeof(Vertex),//stride
+                           0);//offset
+
+    glVertexAttribPointer( loc_color,
+                           3,
+                           GL_FLOAT,
+                           GL_FALSE,
+                           sizeof(Vertex),
+                           (void*)offsetof(Vertex,color));
+
+    //all the matrices go into this frame's part of the ring and one
+    //draw call steps through them, the GPU is still reading the other
+    //parts so nothing waits on it. A frame whose region cannot be mapped
+    //draws them one at a time.
+    size_t bytes = sizeof(glm::mat4) * mvps.size();
+    if( instancing && !mvps.empty() && ringBeginFrame(frameRing, bytes + sizeof(glm::mat4)) )
+    {
+      void *data;
+      size_t offset = ringAlloc(frameRing, bytes, sizeof(glm::mat4), &data);
+      memcpy(data, &mvps[0], bytes);
+      ringFinishWrites(frameRing);
+      glBindBuffer(GL_ARRAY_BUFFER, frameRing.buffer);
+      for (int c=0;c<4; c++)
+      {
+        glEnableVertexAttribArray(loc_mvp + c);
+        glVertexAttribPointer( loc_mvp + c,
+                               4,
+                               GL_FLOAT,
+                               GL_FALSE,
+                               sizeof(glm::mat4),
+                               (void*)(offset + sizeof(glm::vec4) * c));//one column each
+      }
+
+      glDrawArraysInstanced(GL_TRIANGLES, 0, 36, mvps.size());//mode, starting index, count, instances
+      ringEndFrame(frameRing);
+
+      for (int c=0;c<4; c++)
+        glDisableVertexAttribArray(loc_mvp + c);
+    }
+    else
+    {
+      //no instancing, the matrix is a constant attribute per draw
+      for (unsigned int i=0;i<mvps.size(); i++) 
+      {
+        for (int c=0;c<4; c++)
+          glVertexAttrib4fv(loc_mvp + c, glm::value_ptr(mvps[i][c]));
+
+        glDrawArrays(GL_TRIANGLES, 0, 36);//mode, starting index, count
+      }
     }
     //clean up
     glDisableVertexAttribArray(loc_position);
     glDisableVertexAttribArray(loc_color);
+
+    //all the text queued above goes on top in one draw
+    textDraw(w, h);
+
+    //queues the copy for --capture, the pixels are written out later
+    captureFrame(w, h);
                            
+    frameStatsGpuEnd();
+    frameStatsEnd(STAGE_RENDER);
+
     //swap the buffers
-    glutSwapBuffers(); 
+    frameStatsBegin(STAGE_SWAP);
+    if( headless )
+        headlessSwapBuffers();
+    else
+        glutSwapBuffers();
+    frameStatsEnd(STAGE_SWAP);
+    frameStatsEndFrame(); 
     
 }
 
 void update()
+{
+    frameStatsBegin(STAGE_UPDATE);
+
+    //with --fixed-dt there is no simulation thread, the clock moves on by
+    //the step every frame and the steps that came due are taken here, so
+    //every run draws exactly the same frames
+    if( fixedStep > 0 )
+    {
+      static double next = 1.0 / SIM_RATE;
+      fixedClock += fixedStep;
+      if( PAUSED )
+        next = fixedClock + 1.0 / SIM_RATE;
+      while( next <= fixedClock )
+      {
+        step(1.0 / SIM_RATE);
+        publishSnapshot(next);
+        next += 1.0 / SIM_RATE;
+      }
+    }
+
+    //take the newest snapshot, the one we had becomes the previous one
+    //(swapping the vectors hands the old storage back with the slot)
+    if( snapshots.fresh() )
+    {
+      Snapshot &old = snapshots.front();
+      previousWorlds.swap(old.worlds);
+      previousTime = old.time;
+      snapshots.acquire();
+    }
+    const Snapshot &current = snapshots.front();
+
+    //draw one step in the past so there are always two states to blend
+    float alpha = 1.0f;
+    if( current.time > previousTime && previousWorlds.size() == current.worlds.size() )
+    {
+      alpha = (simSeconds() - 1.0 / SIM_RATE - previousTime) / (current.time - previousTime);
+      alpha = std::min(std::max(alpha, 0.0f), 1.0f);
+    }
+    sceneSettled = alpha >= 1.0f;
+
+    size_t count = current.worlds.size();
+    blendedWorlds.resize(count);
+    for (size_t i=0;i<count; i++)
+    {
+      const glm::mat4 &to = current.worlds[i];
+      if( alpha < 1.0f )
+      {
+        //close enough for the small angles one step covers
+        const glm::mat4 &from = previousWorlds[i];
+        for (int c=0;c<4; c++)
+          blendedWorlds[i][c] = from[c] + (to[c] - from[c]) * alpha;
+      }
+      else
+      {
+        blendedWorlds[i] = to;
+      }
+    }
+
+    //cubes outside the view are dropped here, so they cost neither a
+    //transform nor any GL work
+    vp = projection * view;
+    Frustum frustum;
+    frustumFromMatrix(vp, frustum);
+    visibleIndices.resize(count);
+    size_t visibleCount = count > 0 ? cullSpheres(frustum, &blendedWorlds[0], count, glm::vec3(0.0f),
+                                                  CUBE_RADIUS, &visibleIndices[0]) : 0;
+    visibleWorlds.resize(visibleCount);
+    for (size_t i=0;i<visibleCount; i++)
+      visibleWorlds[i] = blendedWorlds[visibleIndices[i]];
+    frameStatsCounts(visibleCount, count - visibleCount);
+
+    //view and projection are the same for everything, the model
+    //matrices are multiplied in all at once with SIMD
+    mvps.resize(visibleCount);
+    if( visibleCount > 0 )
+      transformBatch(vp, &visibleWorlds[0], &mvps[0], visibleCount);
+
+    frameStatsEnd(STAGE_UPDATE);
+    // Update the state of the scene
+    if( !headless )
+        glutPostRedisplay();//call the display callback
+}
+
+//The idle callback, paces the frames instead of spinning
+void idle()
+{
+    //a paused scene stops changing once the last snapshot is drawn
+    bool changing = !onDemand || !PAUSED || snapshots.fresh() || !sceneSettled;
+    bool asked = pacerTakeRequest();
+    if( !windowVisible || !(changing || asked) )
+    {
+        //nothing new to draw: stop the idle calls, GLUT then blocks waiting
+        //for events until input or the window coming back asks for a frame
+        glutIdleFunc(NULL);
+        return;
+    }
+    pacerWait();
+    update();
+}
+
+void visibility(int state)
+{
+    windowVisible = state == GLUT_VISIBLE;
+    if( windowVisible )
+        requestFrame();
+}
+
+//Input changed something, draw it even when drawing on demand
+void requestFrame()
+{
+    pacerRequestFrame();
+    glutIdleFunc(idle);
+}
+
+//Runs on its own thread until simRunning is cleared
+void simulate()
+{
+    const double stepLength = 1.0 / SIM_RATE;
+    double next = stepLength;
+    while( simRunning )
+    {
+      double now = simSeconds();
+      //nothing steps while paused or hidden, the clock skips the gap
+      if( PAUSED || !windowVisible )
+      {
+        next = now + stepLength;
+        std::this_thread::sleep_for(std::chrono::duration<double>(stepLength));
+        continue;
+      }
+      if( now < next )
+      {
+        std::this_thread::sleep_for(std::chrono::duration<double>(next - now));
+        continue;
+      }
+      //way behind (a slow machine or a debugger), skip ahead instead of
+      //trying to catch up
+      if( now - next > 0.25 )
+        next = now;
+
+      step(stepLength);
+      publishSnapshot(next);
+      simStepTime = (simSeconds() - now) * 1000.0;
+      next += stepLength;
+    }
+}
+
+//Advances the scene by dt seconds
+void step(float dt)
 {
     //total time
     static float angle = 0.0;
     static float rotAngle = 0.0;
     static float moonAngle = 0.0;
-    
-    float dt = getDT();// if you have anything moving, use dt.
 
     angle += dt * M_PI/2 * PLANET_MOD; //move through 90 degrees a second
     
     moonAngle += dt * M_PI; //move through 180 degrees a second
-    if( ROTATION_FLAG )
+    bool rotating = ROTATION_FLAG;
+    if( rotating )
     {
       rotAngle += dt*90*SPIN_MOD*SPEED_MOD; //rotate 90 degrees a second * SPEED_MOD
     }
     
-    //THIS IS THE PLANET'S UPDATE
-    models[0] = glm::translate( glm::mat4(1.0f), glm::vec3(4.0 * sin(angle), 0.0, 4.0 * cos(angle)));
-    models[0] = glm::rotate(models[0], rotAngle, glm::vec3(0, 1, 0));
+    //every planet animates on its own, so they are spread over the pool
+    parallelFor(0, planetNodes.size(), 1024, [&](size_t first, size_t last)
+    {
+      for (size_t i=first;i<last; i++)
+      {
+        //spread the pairs out along their orbits
+        float phase = i * 2.4f;
+
+        //THIS IS THE PLANET'S UPDATE
+        sceneSetTranslation(scene, planetNodes[i], glm::vec3(4.0 * sin(angle + phase), 0.0, 4.0 * cos(angle + phase)));
+        if( rotating )
+          sceneSetRotation(scene, bodyNodes[i], rotAngle, glm::vec3(0, 1, 0));
     
-    //THIS IS THE MOON'S UPDATE
-    models[1] = glm::translate( glm::mat4(1.0f), glm::vec3(4.0 * sin(angle), 0.0, 4.0 * cos(angle)));
-    models[1] = glm::translate( models[1], glm::vec3(3.0 * sin(moonAngle), 0.0, 3.0 * cos(moonAngle)));
-    // Update the state of the scene
-    glutPostRedisplay();//call the display callback
+        //THIS IS THE MOON'S UPDATE, it follows the planet on its own
+        sceneSetTranslation(scene, moonNodes[i], glm::vec3(3.0 * sin(moonAngle + phase), 0.0, 3.0 * cos(moonAngle + phase)));
+      }
+    });
+
+    //only what moved gets its world matrix rebuilt (a level at a time,
+    //each level in parallel)
+    sceneUpdate(scene);
+}
+
+//Copies the model matrices out for the render thread
+void publishSnapshot(double time)
+{
+    Snapshot &snapshot = snapshots.back();
+    snapshot.time = time;
+    snapshot.worlds.assign(scene.worlds.begin() + firstModel, scene.worlds.begin() + firstModel + modelCount);
+    snapshots.publish();
+}
+
+double simSeconds()
+{
+    if( fixedStep > 0 )
+        return fixedClock;
+    return std::chrono::duration_cast< std::chrono::duration<double> >(std::chrono::high_resolution_clock::now() - simStart).count();
+}
+
+//Safe to call more than once
+void stopThreads()
+{
+    simRunning = false;
+    if( simThread.joinable() )
+        simThread.join();
+    threadPoolStop();
 }
 
 
@@ -225,7 +672,7 @@ void reshape(int n_w, int n_h)
     //Update the projection matrix as well
     //See the init function for an explaination
     projection = glm::perspective(45.0f, float(w)/float(h), 0.01f, 100.0f);
-
+    requestFrame();
 }
 
 void keyboard(unsigned char key, int x_pos, int y_pos)
@@ -234,22 +681,31 @@ void keyboard(unsigned char key, int x_pos, int y_pos)
     // Handle keyboard input
     if( key == 65 || key == 97 )//a or A
     {
-        SPIN_MOD *= -1;
+        SPIN_MOD = -SPIN_MOD;
     }
     if( key == 45 || key == 95 ) // - or _
     {
       if( SPEED_MOD > 1 )
-        SPEED_MOD -= 0.5;
+        SPEED_MOD = SPEED_MOD - 0.5f;
     }
     if( key == 43 || key == 61) // + or =
     {
       if( SPEED_MOD < 5 )
-        SPEED_MOD += 0.5;
+        SPEED_MOD = SPEED_MOD + 0.5f;
+    }
+    if( key == 72 || key == 104 )//h or H
+    {
+        SHOW_STATS = !SHOW_STATS;
+    }
+    if( key == 80 || key == 112 )//p or P
+    {
+        PAUSED = !PAUSED;
     }
     if(key == 27)//ESC
     {
         exit(0);
     }
+    requestFrame();
 }
 void keypressSpecial (int key, int x, int y)
 {	
@@ -263,14 +719,15 @@ void keypressSpecial (int key, int x, int y)
   {
     PLANET_MOD=1;
   }
-	
+  requestFrame();
 }
 void mouse(int button, int state, int x, int y)
 {
   if(button == GLUT_LEFT_BUTTON && state == GLUT_DOWN)
   {
-    SPIN_MOD *= -1;
+    SPIN_MOD = -SPIN_MOD;
   }
+  requestFrame();
 }
 
 bool initialize()
@@ -334,79 +791,85 @@ bool initialize()
 
     //--Geometry done
 
-    GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-
     //Shader Sources
     // Now uses the shader loader
     // Given our current file structure, these paths should always work
     const char *vs = loadShaderFromFile("assets/shaders/vs.txt");
     const char *fs = loadShaderFromFile("assets/shaders/fs.txt");
-    
-    //compile the shaders
-    GLint shader_status;
 
-    // Vertex shader first
-    glShaderSource(vertex_shader, 1, &vs, NULL);
-    glCompileShader(vertex_shader);
-    //check the compile status
-    glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &shader_status);
-    if(!shader_status)
+    //A binary left by an earlier run skips compiling and linking, as long
+    //as the sources and the driver are the same and the driver takes it
+    program = loadProgramBinary(PROGRAM_CACHE_FILE, vs, fs);
+    if( program == 0 )
     {
-        std::cerr << "[F] FAILED TO COMPILE VERTEX SHADER!" << std::endl;
-        return false;
-    }
+        GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+        GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
 
-    // Now the Fragment shader
-    glShaderSource(fragment_shader, 1, &fs, NULL);
-    glCompileShader(fragment_shader);
-    //check the compile status
-    glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &shader_status);
-    if(!shader_status)
-    {
-        std::cerr << "[F] FAILED TO COMPILE FRAGMENT SHADER!" << std::endl;
-        return false;
-    }
+        //compile the shaders
+        GLint shader_status;
 
-    //Now we link the 2 shader objects into a program
-    //This program is what is run on the GPU
-    program = glCreateProgram();
-    glAttachShader(program, vertex_shader);
-    glAttachShader(program, fragment_shader);
-    glLinkProgram(program);
-    //check if everything linked ok
-    glGetProgramiv(program, GL_LINK_STATUS, &shader_status);
-    if(!shader_status)
-    {
-        std::cerr << "[F] THE SHADER PROGRAM FAILED TO LINK" << std::endl;
-        return false;
+        // Vertex shader first
+        glShaderSource(vertex_shader, 1, &vs, NULL);
+        glCompileShader(vertex_shader);
+        //check the compile status
+        glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &shader_status);
+        if(!shader_status)
+        {
+            std::cerr << "[F] FAILED TO COMPILE VERTEX SHADER!" << std::endl;
+            return false;
+        }
+
+        // Now the Fragment shader
+        glShaderSource(fragment_shader, 1, &fs, NULL);
+        glCompileShader(fragment_shader);
+        //check the compile status
+        glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &shader_status);
+        if(!shader_status)
+        {
+            std::cerr << "[F] FAILED TO COMPILE FRAGMENT SHADER!" << std::endl;
+            return false;
+        }
+
+        //Now we link the 2 shader objects into a program
+        //This program is what is run on the GPU
+        program = glCreateProgram();
+        glAttachShader(program, vertex_shader);
+        glAttachShader(program, fragment_shader);
+        bindAttributes(program);
+        requestProgramBinary(program);
+        glLinkProgram(program);
+        //check if everything linked ok
+        glGetProgramiv(program, GL_LINK_STATUS, &shader_status);
+        if(!shader_status)
+        {
+            std::cerr << "[F] THE SHADER PROGRAM FAILED TO LINK" << std::endl;
+            return false;
+        }
+
+        //the shader objects are part of the program now
+        glDeleteShader(vertex_shader);
+        glDeleteShader(fragment_shader);
+        saveProgramBinary(PROGRAM_CACHE_FILE, program, vs, fs);
     }
 
+    //Instanced drawing needs per instance attributes (GL 3.3)
+    //without them every model is still its own draw call
+    //the matrices go through the ring, room for every model to begin with
+    instancing = GLEW_VERSION_3_3 &&
+                 ringInit(frameRing, sizeof(glm::mat4) * planetCount * 2);
+
     //Now we set the locations of the attributes and uniforms
     //this allows us to access them easily while rendering
-    loc_position = glGetAttribLocation(program,
-                    const_cast<const char*>("v_position"));
-    if(loc_position == -1)
-    {
-        std::cerr << "[F] POSITION NOT FOUND" << std::endl;
+    if( !bindProgram(program) )
         return false;
-    }
 
-    loc_color = glGetAttribLocation(program,
-                    const_cast<const char*>("v_color"));
-    if(loc_color == -1)
-    {
-        std::cerr << "[F] V_COLOR NOT FOUND" << std::endl;
-        return false;
-    }
+    //edits to the shaders are picked up while running
+    if( !shaderWatchInit("assets/shaders", "vs.txt", "fs.txt", PROGRAM_CACHE_FILE, bindAttributes) )
+        std::cout << "WARNING: Could not watch assets/shaders, shader reload is off" << std::endl;
 
-    loc_mvpmat = glGetUniformLocation(program,
-                    const_cast<const char*>("mvpMatrix"));
-    if(loc_mvpmat == -1)
-    {
-        std::cerr << "[F] MVPMATRIX NOT FOUND" << std::endl;
-        return false;
-    }
+    //the font is baked once, the overlay text is drawn with it every frame
+    if( !textInit() )
+        std::cout << "WARNING: No text overlay" << std::endl;
     
     //--Init the view and projection matrices
     //  if you will be having a moving camera the view matrix will need to more dynamic
@@ -425,23 +888,121 @@ bool initialize()
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LESS);
 
-    //load our models
-    models.push_back(model);
-    models.push_back(model);
+    //load our models, a planet and a moon for each orbit
+    //more than one pair are laid out on a grid going away from the camera
+    sceneInit(scene);
+    int side = (int)ceil(sqrt((float)planetCount));
+    std::vector<int> systemNodes;
+    for (int i=0;i<planetCount; i++)
+    {
+      systemNodes.push_back(sceneAddNode(scene, -1));
+      sceneSetTranslation(scene, systemNodes[i], glm::vec3(((i % side) - (side - 1) / 2.0f) * 16.0f, 0.0f, (i / side) * 16.0f));
+    }
+    for (int i=0;i<planetCount; i++)
+      planetNodes.push_back(sceneAddNode(scene, systemNodes[i]));
+    firstModel = scene.parents.size();
+    for (int i=0;i<planetCount; i++)
+    {
+      bodyNodes.push_back(sceneAddNode(scene, planetNodes[i]));
+      moonNodes.push_back(sceneAddNode(scene, planetNodes[i]));
+    }
+    modelCount = scene.parents.size() - firstModel;
+    sceneUpdate(scene);
     //and its done
     return true;
 }
 
+void bindAttributes(GLuint newProgram)
+{
+    //keep the per vertex position on attribute 0, the mvp matrix can
+    //then be a constant attribute when there is no instancing
+    glBindAttribLocation(newProgram, 0, "v_position");
+}
+
+bool bindProgram(GLuint newProgram)
+{
+    //look everything up before touching the globals, a reloaded program
+    //that is missing something must leave the old one fully in place
+    GLint position = glGetAttribLocation(newProgram,
+                    const_cast<const char*>("v_position"));
+    if(position == -1)
+    {
+        std::cerr << "[F] POSITION NOT FOUND" << std::endl;
+        return false;
+    }
+
+    GLint color = glGetAttribLocation(newProgram,
+                    const_cast<const char*>("v_color"));
+    if(color == -1)
+    {
+        std::cerr << "[F] V_COLOR NOT FOUND" << std::endl;
+        return false;
+    }
+
+    GLint mvp = glGetAttribLocation(newProgram,
+                    const_cast<const char*>("v_mvp"));
+    if(mvp == -1)
+    {
+        std::cerr << "[F] V_MVP NOT FOUND" << std::endl;
+        return false;
+    }
+
+    if( instancing )
+    {
+        //the divisors belong to the locations, not the program
+        if( newProgram != program )
+            for (int c=0;c<4; c++)
+                glVertexAttribDivisor(loc_mvp + c, 0);
+        for (int c=0;c<4; c++)
+            glVertexAttribDivisor(mvp + c, 1);// advance once per instance
+    }
+
+    program = newProgram;
+    loc_position = position;
+    loc_color = color;
+    loc_mvp = mvp;
+    return true;
+}
+
+void reloadShaders()
+{
+    //swaps in a rebuilt program once the driver has finished it, the
+    //frames before that keep drawing with the old one
+    GLuint reloaded = shaderWatchPoll();
+    if( reloaded == 0 )
+        return;
+    GLuint old = program;
+    if( bindProgram(reloaded) )
+    {
+        glDeleteProgram(old);
+        std::cout << "Shaders reloaded" << std::endl;
+    }
+    else
+    {
+        glDeleteProgram(reloaded);
+        std::cout << "WARNING: Reloaded program is missing attributes, keeping the old program" << std::endl;
+    }
+}
+
 void cleanUp()
 {
     // Clean up, Clean up
+    shaderWatchStop();
+    captureStop();
+    frameStatsCleanUp();
+    textCleanUp();
     glDeleteProgram(program);
     glDeleteBuffers(1, &vbo_geometry);
+    if( instancing )
+        ringCleanUp(frameRing);
+    stopThreads();
 }
 
 //returns the time delta
 float getDT()
 {
+    if( fixedStep > 0 )
+        return fixedStep;
     float ret;
     t2 = std::chrono::high_resolution_clock::now();
     ret = std::chrono::duration_cast< std::chrono::duration<float> >(t2-t1).count();
@@ -469,7 +1030,7 @@ const char* loadShaderFromFile(const char* fileName)
     throw;
   }
   
-  char * shader = new char[fileContents.size()];
+  char * shader = new char[fileContents.size() + 1];// and the terminator
   strcpy(shader, fileContents.c_str());
   return shader;
 }
@@ -491,28 +1052,6 @@ void rotation_menu(int id)
       exit(0);
       break;
   }
-  glutPostRedisplay();
-}
-
-void glutPrintText(float x, float y, char* text, void * font, 
-                              float r, float g, float b, float a)
-{
-    // disable shaders
-    glUseProgram(0);
-
-    // set color of text
-    glColor3f(r,g,b);
-
-    // set position of text
-    glRasterPos2f(x,y);
-    
-    // iterate through string to print text
-    while (*text) {
-        glutBitmapCharacter(font, *text);
-        text++;
-    }
- 
-    // re-enable shaders
-    glUseProgram(program);
+  requestFrame();
 }
 
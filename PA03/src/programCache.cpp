@@ -0,0 +1,139 @@
+#include "programCache.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+#include <string>
+
+struct ProgramCacheHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t key;// hash of the sources and the driver
+    uint32_t format;// from glGetProgramBinary
+    uint32_t length;// bytes of binary after the header
+};
+
+static uint64_t hashString(uint64_t hash, const char *text)
+{
+    //FNV-1a, the terminator goes in too so "ab"+"c" differs from "a"+"bc"
+    if( text == NULL )
+        text = "";
+    do
+    {
+        hash ^= (unsigned char)*text;
+        hash *= 1099511628211ULL;
+    } while( *text++ );
+    return hash;
+}
+
+static uint64_t programKey(const char *vertexSource, const char *fragmentSource)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    hash = hashString(hash, vertexSource);
+    hash = hashString(hash, fragmentSource);
+    hash = hashString(hash, (const char*)glGetString(GL_VENDOR));
+    hash = hashString(hash, (const char*)glGetString(GL_RENDERER));
+    hash = hashString(hash, (const char*)glGetString(GL_VERSION));
+    return hash;
+}
+
+bool programBinarySupported()
+{
+    if( !GLEW_ARB_get_program_binary && !GLEW_VERSION_4_1 )
+        return false;
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+GLuint loadProgramBinary(const char *cacheFileName,
+                         const char *vertexSource, const char *fragmentSource)
+{
+    if( !programBinarySupported() )
+        return 0;
+    FILE *file = fopen(cacheFileName, "rb");
+    if( file == NULL )
+        return 0;
+
+    ProgramCacheHeader header;
+    std::vector<char> binary;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+              memcmp(header.magic, PROGRAM_CACHE_MAGIC, 4) == 0 &&
+              header.version == PROGRAM_CACHE_VERSION &&
+              header.key == programKey(vertexSource, fragmentSource) &&
+              header.length > 0 && header.length <= (64u << 20);
+    if( ok )
+    {
+        binary.resize(header.length);
+        ok = fread(&binary[0], 1, header.length, file) == header.length;
+    }
+    fclose(file);
+    if( !ok )
+        return 0;
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.format, &binary[0], header.length);
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if( !status )
+    {
+        //the driver changed its mind about the binary, compile from source
+        //(and drop the error it may have raised about the format)
+        glDeleteProgram(program);
+        while( glGetError() != GL_NO_ERROR )
+            ;
+        return 0;
+    }
+    return program;
+}
+
+void requestProgramBinary(GLuint program)
+{
+    if( GLEW_ARB_get_program_binary || GLEW_VERSION_4_1 )
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+bool saveProgramBinary(const char *cacheFileName, GLuint program,
+                       const char *vertexSource, const char *fragmentSource)
+{
+    if( !programBinarySupported() )
+        return false;
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if( length <= 0 )
+        return false;
+
+    ProgramCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, &binary[0]);
+    if( written <= 0 )
+        return false;
+    memcpy(header.magic, PROGRAM_CACHE_MAGIC, 4);
+    header.version = PROGRAM_CACHE_VERSION;
+    header.key = programKey(vertexSource, fragmentSource);
+    header.format = format;
+    header.length = written;
+
+    //write to a temporary name first so a crash never leaves half a binary
+    std::string tempName = std::string(cacheFileName) + ".tmp";
+    FILE *file = fopen(tempName.c_str(), "wb");
+    if( file == NULL )
+    {
+        printf("WARNING: Could not write program cache %s\n", cacheFileName);
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(&binary[0], 1, written, file) == (size_t)written;
+    ok = (fclose(file) == 0) && ok;
+    if( !ok || rename(tempName.c_str(), cacheFileName) != 0 )
+    {
+        remove(tempName.c_str());
+        printf("WARNING: Could not write program cache %s\n", cacheFileName);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,148 @@
+#include "sceneGraph.h"
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+#include "threadPool.h"
+
+//nodes per piece of a parallel update
+#define UPDATE_GRAIN 2048
+
+void sceneInit(SceneGraph &graph)
+{
+    graph.parents.clear();
+    graph.translations.clear();
+    graph.angles.clear();
+    graph.axes.clear();
+    graph.scales.clear();
+    graph.locals.clear();
+    graph.worlds.clear();
+    graph.dirty.clear();
+    graph.stamps.clear();
+    graph.updateCount = 1;// stamps start at 0, so nothing reads as changed
+    graph.firstDirty = 0;
+    graph.depths.clear();
+    graph.levelStarts.clear();
+    graph.levelOrdered = true;
+}
+
+int sceneAddNode(SceneGraph &graph, int parent)
+{
+    int node = graph.parents.size();
+    if( parent >= node )
+        parent = -1;// parents have to come first
+
+    graph.parents.push_back(parent);
+    graph.translations.push_back(glm::vec3(0.0f));
+    graph.angles.push_back(0.0f);
+    graph.axes.push_back(glm::vec3(0.0f, 1.0f, 0.0f));
+    graph.scales.push_back(glm::vec3(1.0f));
+    graph.locals.push_back(glm::mat4(1.0f));
+    graph.worlds.push_back(glm::mat4(1.0f));
+    graph.dirty.push_back(1);
+    graph.stamps.push_back(0);
+    graph.firstDirty = std::min(graph.firstDirty.load(), (size_t)node);
+
+    int depth = parent >= 0 ? graph.depths[parent] + 1 : 0;
+    if( node == 0 || depth != graph.depths.back() )
+        graph.levelStarts.push_back(node);
+    if( node > 0 && depth < graph.depths.back() )
+        graph.levelOrdered = false;
+    graph.depths.push_back(depth);
+    return node;
+}
+
+static void markDirty(SceneGraph &graph, int node)
+{
+    graph.dirty[node] = 1;
+    size_t first = graph.firstDirty.load(std::memory_order_relaxed);
+    while( (size_t)node < first &&
+           !graph.firstDirty.compare_exchange_weak(first, node, std::memory_order_relaxed) )
+        ;
+}
+
+void sceneSetTranslation(SceneGraph &graph, int node, const glm::vec3 &translation)
+{
+    graph.translations[node] = translation;
+    markDirty(graph, node);
+}
+
+void sceneSetRotation(SceneGraph &graph, int node, float angle, const glm::vec3 &axis)
+{
+    graph.angles[node] = angle;
+    graph.axes[node] = axis;
+    markDirty(graph, node);
+}
+
+void sceneSetScale(SceneGraph &graph, int node, const glm::vec3 &scale)
+{
+    graph.scales[node] = scale;
+    markDirty(graph, node);
+}
+
+//Every node transform is affine (bottom row 0 0 0 1), which saves a
+//quarter of a full matrix multiply
+static void affineMultiply(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &result)
+{
+    for( int c = 0; c < 3; c++ )
+        result[c] = a[0] * b[c].x + a[1] * b[c].y + a[2] * b[c].z;
+    result[3] = a[0] * b[3].x + a[1] * b[3].y + a[2] * b[3].z + a[3];
+}
+
+//Updates the nodes [begin, end), their parents have to be up to date
+static void updateNodes(SceneGraph &graph, size_t begin, size_t end)
+{
+    for( size_t i = begin; i < end; i++ )
+    {
+        int parent = graph.parents[i];
+        bool parentChanged = parent >= 0 && graph.stamps[parent] == graph.updateCount;
+        if( !graph.dirty[i] && !parentChanged )
+            continue;
+
+        if( graph.dirty[i] )
+        {
+            //most nodes only move, so skip the rotation when there is none
+            //and fill in the translation directly
+            glm::mat4 &local = graph.locals[i];
+            local = graph.angles[i] != 0.0f ? glm::rotate(glm::mat4(1.0f), graph.angles[i], graph.axes[i])
+                                            : glm::mat4(1.0f);
+            const glm::vec3 &scale = graph.scales[i];
+            local[0] *= scale.x;
+            local[1] *= scale.y;
+            local[2] *= scale.z;
+            local[3] = glm::vec4(graph.translations[i], 1.0f);
+            graph.dirty[i] = 0;
+        }
+
+        if( parent >= 0 )
+            affineMultiply(graph.worlds[parent], graph.locals[i], graph.worlds[i]);
+        else
+            graph.worlds[i] = graph.locals[i];
+        graph.stamps[i] = graph.updateCount;
+    }
+}
+
+void sceneUpdate(SceneGraph &graph)
+{
+    graph.updateCount++;
+    size_t count = graph.parents.size();
+    size_t first = graph.firstDirty;
+    if( !graph.levelOrdered )
+    {
+        updateNodes(graph, first, count);
+    }
+    else
+    {
+        //a level only reads the one above it, which is finished by then
+        for( size_t level = 0; level < graph.levelStarts.size(); level++ )
+        {
+            size_t begin = std::max(graph.levelStarts[level], first);
+            size_t end = level + 1 < graph.levelStarts.size() ? graph.levelStarts[level + 1] : count;
+            if( begin >= end )
+                continue;
+            parallelFor(begin, end, UPDATE_GRAIN, [&](size_t from, size_t to)
+            {
+                updateNodes(graph, from, to);
+            });
+        }
+    }
+    graph.firstDirty = count;
+}
@@ -0,0 +1,62 @@
+#ifndef SCENEGRAPH_H
+#define SCENEGRAPH_H
+
+#include <vector>
+#include <atomic>
+#include <glm/glm.hpp>
+
+//--Scene graph
+// Nodes live in flat arrays, parents always before their children, so one
+// pass front to back is enough to bring every world matrix up to date.
+// Each node has a local translate/rotate/scale. Changing one marks the node
+// dirty, and sceneUpdate only rebuilds dirty nodes and the nodes below them.
+// Everything else keeps last frame's matrices.
+//
+// Nodes may be changed from several threads at once (different nodes). When
+// nodes are added a level at a time, so every node is deeper than or as
+// deep as the one before it, sceneUpdate spreads each level over the
+// thread pool.
+
+struct SceneGraph
+{
+    std::vector<int> parents;// -1 for a root
+
+    //local transform, applied scale first, then rotate, then translate
+    std::vector<glm::vec3> translations;
+    std::vector<float> angles;// degrees
+    std::vector<glm::vec3> axes;
+    std::vector<glm::vec3> scales;
+
+    std::vector<glm::mat4> locals;
+    std::vector<glm::mat4> worlds;
+
+    std::vector<unsigned char> dirty;// local transform needs rebuilding
+    std::vector<unsigned int> stamps;// update that last rebuilt the world matrix
+    unsigned int updateCount;
+    std::atomic<size_t> firstDirty;// nothing before this node changed since the last update
+
+    std::vector<int> depths;// roots are 0
+    std::vector<size_t> levelStarts;// first node of every run of equal depth
+    bool levelOrdered;// depths never go down, so the runs are whole levels
+};
+
+void sceneInit(SceneGraph &graph);
+
+//Adds a node with an identity transform and returns its index, the parent
+//has to exist already (or be -1)
+int sceneAddNode(SceneGraph &graph, int parent);
+
+void sceneSetTranslation(SceneGraph &graph, int node, const glm::vec3 &translation);
+void sceneSetRotation(SceneGraph &graph, int node, float angle, const glm::vec3 &axis);
+void sceneSetScale(SceneGraph &graph, int node, const glm::vec3 &scale);
+
+//Brings the world matrices of dirty subtrees up to date
+void sceneUpdate(SceneGraph &graph);
+
+//True if the node's world matrix changed in the last sceneUpdate
+inline bool sceneChanged(const SceneGraph &graph, int node)
+{
+    return graph.stamps[node] == graph.updateCount;
+}
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef SHADERRELOAD_H
+#define SHADERRELOAD_H
+
+#include <GL/glew.h> // glew must be included before the main gl libs
+
+//--Shader hot reload
+// Watches the shader directory with inotify. When the vertex or fragment
+// shader is saved, a new program is built next to the one in use, one step
+// a frame (vertex shader, fragment shader, link) so the parsing drivers do
+// on the calling thread is spread out. With GL_KHR_parallel_shader_compile
+// the rest happens on the driver's threads and the program is only handed
+// out once GL_COMPLETION_STATUS_KHR says it is done, so no frame waits on
+// it. A program that fails to build is thrown away with its log printed,
+// and the old one stays in use.
+//
+// Everything here runs on the thread that owns the GL context.
+
+//Called on every new program before it is linked, to bind attribute
+//locations and the like
+typedef void (*ProgramSetup)(GLuint program);
+
+//Starts watching, false if the directory cannot be watched (or this is not
+//Linux). cacheFileName is where a successfully reloaded program binary goes.
+bool shaderWatchInit(const char *directory, const char *vertexFile,
+                     const char *fragmentFile, const char *cacheFileName,
+                     ProgramSetup setup);
+
+//Call once a frame. Returns a newly linked program when one has finished,
+//0 otherwise. The caller owns it (and the program it replaces).
+GLuint shaderWatchPoll();
+
+void shaderWatchStop();
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef STREAMRING_H
+#define STREAMRING_H
+
+#include <GL/glew.h> // glew must be included before the main gl libs
+#include <stddef.h>
+
+//--Per frame data ring
+// One buffer split into STREAM_RING_REGIONS regions. Each frame writes its
+// data (uniform blocks, instance matrices) into the next region, and a
+// fence after the frame's draws marks when the GPU is done with it. A
+// region is only written again once its fence has passed, so with three of
+// them the CPU runs up to two frames ahead and never waits on the driver
+// the way orphaning a buffer with glBufferData can.
+//
+// With GL_ARB_buffer_storage the buffer is mapped once, persistent and
+// coherent, for its whole life. Without it the region is mapped
+// unsynchronized at the start of every frame instead (the fences already
+// say it is free) and unmapped by ringFinishWrites, since GL does not let
+// a draw read a buffer that is mapped without the persistent bit.
+
+#define STREAM_RING_REGIONS 3
+
+struct StreamRing
+{
+    GLuint buffer;
+    size_t regionSize;
+    unsigned int region;// the region this frame writes
+    size_t used;// bytes of it handed out so far
+    char *mapped;// the whole buffer when persistent, just the region if not
+    bool persistent;
+    GLsync fences[STREAM_RING_REGIONS];
+    unsigned long stalls;// frames that had to wait for the GPU
+};
+
+//Needs GL 3.2 (map buffer range and sync objects), false if it is missing
+bool ringInit(StreamRing &ring, size_t regionSize);
+
+//Moves to the next region, waiting for the GPU to finish with it first.
+//bytes is all this frame will ask for, the buffer grows to fit if need be
+//(alignment padding included, so leave some slack). False when the region
+//could not be mapped, the frame then does without the ring (no ringAlloc
+//and no ringEndFrame).
+bool ringBeginFrame(StreamRing &ring, size_t bytes);
+
+//Space for this frame's data, data points at it for writing. Returns its
+//offset in ring.buffer for glBindBufferRange or attribute pointers.
+size_t ringAlloc(StreamRing &ring, size_t bytes, size_t alignment, void **data);
+
+//Call once this frame's data is written, before binding the buffer for
+//anything that reads it. No more ringAlloc after this until the next frame.
+void ringFinishWrites(StreamRing &ring);
+
+//Call after the last draw that reads this frame's data
+void ringEndFrame(StreamRing &ring);
+
+void ringCleanUp(StreamRing &ring);
+
+#endif
@@ -0,0 +1,379 @@
+#include "textOverlay.h"
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+//8x8 ASCII font, ' ' to '~', one byte per row from the top, bit 0 is the
+//leftmost pixel (the public domain font8x8_basic table)
+#define FIRST_GLYPH 32
+#define LAST_GLYPH 126
+#define GLYPH_SIZE 8
+static const unsigned char font8x8[LAST_GLYPH - FIRST_GLYPH + 1][GLYPH_SIZE] = {
+    {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00},// ' '
+    {0x18,0x3C,0x3C,0x18,0x18,0x00,0x18,0x00},// '!'
+    {0x36,0x36,0x00,0x00,0x00,0x00,0x00,0x00},// '"'
+    {0x36,0x36,0x7F,0x36,0x7F,0x36,0x36,0x00},// '#'
+    {0x0C,0x3E,0x03,0x1E,0x30,0x1F,0x0C,0x00},// '$'
+    {0x00,0x63,0x33,0x18,0x0C,0x66,0x63,0x00},// '%'
+    {0x1C,0x36,0x1C,0x6E,0x3B,0x33,0x6E,0x00},// '&'
+    {0x06,0x06,0x03,0x00,0x00,0x00,0x00,0x00},// '''
+    {0x18,0x0C,0x06,0x06,0x06,0x0C,0x18,0x00},// '('
+    {0x06,0x0C,0x18,0x18,0x18,0x0C,0x06,0x00},// ')'
+    {0x00,0x66,0x3C,0xFF,0x3C,0x66,0x00,0x00},// '*'
+    {0x00,0x0C,0x0C,0x3F,0x0C,0x0C,0x00,0x00},// '+'
+    {0x00,0x00,0x00,0x00,0x00,0x0C,0x0C,0x06},// ','
+    {0x00,0x00,0x00,0x3F,0x00,0x00,0x00,0x00},// '-'
+    {0x00,0x00,0x00,0x00,0x00,0x0C,0x0C,0x00},// '.'
+    {0x60,0x30,0x18,0x0C,0x06,0x03,0x01,0x00},// '/'
+    {0x3E,0x63,0x73,0x7B,0x6F,0x67,0x3E,0x00},// '0'
+    {0x0C,0x0E,0x0C,0x0C,0x0C,0x0C,0x3F,0x00},// '1'
+    {0x1E,0x33,0x30,0x1C,0x06,0x33,0x3F,0x00},// '2'
+    {0x1E,0x33,0x30,0x1C,0x30,0x33,0x1E,0x00},// '3'
+    {0x38,0x3C,0x36,0x33,0x7F,0x30,0x78,0x00},// '4'
+    {0x3F,0x03,0x1F,0x30,0x30,0x33,0x1E,0x00},// '5'
+    {0x1C,0x06,0x03,0x1F,0x33,0x33,0x1E,0x00},// '6'
+    {0x3F,0x33,0x30,0x18,0x0C,0x0C,0x0C,0x00},// '7'
+    {0x1E,0x33,0x33,0x1E,0x33,0x33,0x1E,0x00},// '8'
+    {0x1E,0x33,0x33,0x3E,0x30,0x18,0x0E,0x00},// '9'
+    {0x00,0x0C,0x0C,0x00,0x00,0x0C,0x0C,0x00},// ':'
+    {0x00,0x0C,0x0C,0x00,0x00,0x0C,0x0C,0x06},// ';'
+    {0x18,0x0C,0x06,0x03,0x06,0x0C,0x18,0x00},// '<'
+    {0x00,0x00,0x3F,0x00,0x00,0x3F,0x00,0x00},// '='
+    {0x06,0x0C,0x18,0x30,0x18,0x0C,0x06,0x00},// '>'
+    {0x1E,0x33,0x30,0x18,0x0C,0x00,0x0C,0x00},// '?'
+    {0x3E,0x63,0x7B,0x7B,0x7B,0x03,0x1E,0x00},// '@'
+    {0x0C,0x1E,0x33,0x33,0x3F,0x33,0x33,0x00},// 'A'
+    {0x3F,0x66,0x66,0x3E,0x66,0x66,0x3F,0x00},// 'B'
+    {0x3C,0x66,0x03,0x03,0x03,0x66,0x3C,0x00},// 'C'
+    {0x1F,0x36,0x66,0x66,0x66,0x36,0x1F,0x00},// 'D'
+    {0x7F,0x46,0x16,0x1E,0x16,0x46,0x7F,0x00},// 'E'
+    {0x7F,0x46,0x16,0x1E,0x16,0x06,0x0F,0x00},// 'F'
+    {0x3C,0x66,0x03,0x03,0x73,0x66,0x7C,0x00},// 'G'
+    {0x33,0x33,0x33,0x3F,0x33,0x33,0x33,0x00},// 'H'
+    {0x1E,0x0C,0x0C,0x0C,0x0C,0x0C,0x1E,0x00},// 'I'
+    {0x78,0x30,0x30,0x30,0x33,0x33,0x1E,0x00},// 'J'
+    {0x67,0x66,0x36,0x1E,0x36,0x66,0x67,0x00},// 'K'
+    {0x0F,0x06,0x06,0x06,0x46,0x66,0x7F,0x00},// 'L'
+    {0x63,0x77,0x7F,0x7F,0x6B,0x63,0x63,0x00},// 'M'
+    {0x63,0x67,0x6F,0x7B,0x73,0x63,0x63,0x00},// 'N'
+    {0x1C,0x36,0x63,0x63,0x63,0x36,0x1C,0x00},// 'O'
+    {0x3F,0x66,0x66,0x3E,0x06,0x06,0x0F,0x00},// 'P'
+    {0x1E,0x33,0x33,0x33,0x3B,0x1E,0x38,0x00},// 'Q'
+    {0x3F,0x66,0x66,0x3E,0x36,0x66,0x67,0x00},// 'R'
+    {0x1E,0x33,0x07,0x0E,0x38,0x33,0x1E,0x00},// 'S'
+    {0x3F,0x2D,0x0C,0x0C,0x0C,0x0C,0x1E,0x00},// 'T'
+    {0x33,0x33,0x33,0x33,0x33,0x33,0x3F,0x00},// 'U'
+    {0x33,0x33,0x33,0x33,0x33,0x1E,0x0C,0x00},// 'V'
+    {0x63,0x63,0x63,0x6B,0x7F,0x77,0x63,0x00},// 'W'
+    {0x63,0x63,0x36,0x1C,0x1C,0x36,0x63,0x00},// 'X'
+    {0x33,0x33,0x33,0x1E,0x0C,0x0C,0x1E,0x00},// 'Y'
+    {0x7F,0x63,0x31,0x18,0x4C,0x66,0x7F,0x00},// 'Z'
+    {0x1E,0x06,0x06,0x06,0x06,0x06,0x1E,0x00},// '['
+    {0x03,0x06,0x0C,0x18,0x30,0x60,0x40,0x00},// '\'
+    {0x1E,0x18,0x18,0x18,0x18,0x18,0x1E,0x00},// ']'
+    {0x08,0x1C,0x36,0x63,0x00,0x00,0x00,0x00},// '^'
+    {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0xFF},// '_'
+    {0x0C,0x0C,0x18,0x00,0x00,0x00,0x00,0x00},// '`'
+    {0x00,0x00,0x1E,0x30,0x3E,0x33,0x6E,0x00},// 'a'
+    {0x07,0x06,0x06,0x3E,0x66,0x66,0x3B,0x00},// 'b'
+    {0x00,0x00,0x1E,0x33,0x03,0x33,0x1E,0x00},// 'c'
+    {0x38,0x30,0x30,0x3E,0x33,0x33,0x6E,0x00},// 'd'
+    {0x00,0x00,0x1E,0x33,0x3F,0x03,0x1E,0x00},// 'e'
+    {0x1C,0x36,0x06,0x0F,0x06,0x06,0x0F,0x00},// 'f'
+    {0x00,0x00,0x6E,0x33,0x33,0x3E,0x30,0x1F},// 'g'
+    {0x07,0x06,0x36,0x6E,0x66,0x66,0x67,0x00},// 'h'
+    {0x0C,0x00,0x0E,0x0C,0x0C,0x0C,0x1E,0x00},// 'i'
+    {0x30,0x00,0x30,0x30,0x30,0x33,0x33,0x1E},// 'j'
+    {0x07,0x06,0x66,0x36,0x1E,0x36,0x67,0x00},// 'k'
+    {0x0E,0x0C,0x0C,0x0C,0x0C,0x0C,0x1E,0x00},// 'l'
+    {0x00,0x00,0x33,0x7F,0x7F,0x6B,0x63,0x00},// 'm'
+    {0x00,0x00,0x1F,0x33,0x33,0x33,0x33,0x00},// 'n'
+    {0x00,0x00,0x1E,0x33,0x33,0x33,0x1E,0x00},// 'o'
+    {0x00,0x00,0x3B,0x66,0x66,0x3E,0x06,0x0F},// 'p'
+    {0x00,0x00,0x6E,0x33,0x33,0x3E,0x30,0x78},// 'q'
+    {0x00,0x00,0x3B,0x6E,0x66,0x06,0x0F,0x00},// 'r'
+    {0x00,0x00,0x3E,0x03,0x1E,0x30,0x1F,0x00},// 's'
+    {0x08,0x0C,0x3E,0x0C,0x0C,0x2C,0x18,0x00},// 't'
+    {0x00,0x00,0x33,0x33,0x33,0x33,0x6E,0x00},// 'u'
+    {0x00,0x00,0x33,0x33,0x33,0x1E,0x0C,0x00},// 'v'
+    {0x00,0x00,0x63,0x6B,0x7F,0x7F,0x36,0x00},// 'w'
+    {0x00,0x00,0x63,0x36,0x1C,0x36,0x63,0x00},// 'x'
+    {0x00,0x00,0x33,0x33,0x33,0x3E,0x30,0x1F},// 'y'
+    {0x00,0x00,0x3F,0x19,0x0C,0x26,0x3F,0x00},// 'z'
+    {0x38,0x0C,0x0C,0x07,0x0C,0x0C,0x38,0x00},// '{'
+    {0x18,0x18,0x18,0x00,0x18,0x18,0x18,0x00},// '|'
+    {0x07,0x0C,0x0C,0x38,0x0C,0x0C,0x07,0x00},// '}'
+    {0x6E,0x3B,0x00,0x00,0x00,0x00,0x00,0x00} // '~'
+};
+
+//the atlas is a 16 x 8 grid of glyphs, the last two rows unused
+#define ATLAS_COLUMNS 16
+#define ATLAS_WIDTH (ATLAS_COLUMNS * GLYPH_SIZE)
+#define ATLAS_HEIGHT (8 * GLYPH_SIZE)
+
+//one corner of a glyph quad, positions in pixels from the bottom left
+struct TextVertex
+{
+    GLfloat position[2];
+    GLfloat texcoord[2];
+    GLubyte color[4];
+};
+
+static const char *textVertexShader =
+    "attribute vec2 t_position;\n"
+    "attribute vec2 t_texcoord;\n"
+    "attribute vec4 t_color;\n"
+    "uniform vec2 screenSize;\n"
+    "varying vec2 texcoord;\n"
+    "varying vec4 color;\n"
+    "void main(void){\n"
+    "   gl_Position = vec4(t_position / screenSize * 2.0 - 1.0, 0.0, 1.0);\n"
+    "   texcoord = t_texcoord;\n"
+    "   color = t_color;\n"
+    "}\n";
+
+static const char *textFragmentShader =
+    "uniform sampler2D atlas;\n"
+    "varying vec2 texcoord;\n"
+    "varying vec4 color;\n"
+    "void main(void){\n"
+    "   gl_FragColor = vec4(color.rgb, color.a * texture2D(atlas, texcoord).r);\n"
+    "}\n";
+
+static GLuint textProgram;
+static GLuint atlasTexture;
+static GLuint textVbo;
+static GLuint textVao;// 0 without vertex array objects
+static GLint loc_screenSize;
+static GLint loc_atlas;
+static size_t vboSize;
+
+//a string waiting for textDraw
+struct TextLine
+{
+    float x, y;
+    int scale;
+    GLubyte color[4];
+    std::string text;
+};
+static std::vector<TextLine> lines;
+static size_t lineCount;// lines in use, the rest keep their strings' memory
+static std::vector<TextVertex> vertices;// six corners a glyph
+
+static GLuint compileTextShader(GLenum type, const char *source)
+{
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    GLint compiled;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if( !compiled )
+    {
+        char log[512];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        printf("WARNING: Text shader failed to compile\n%s\n", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+static void bakeAtlas()
+{
+    //one byte a texel, 255 where the glyph has a pixel
+    std::vector<GLubyte> texels(ATLAS_WIDTH * ATLAS_HEIGHT, 0);
+    for (int c=FIRST_GLYPH;c<=LAST_GLYPH; c++)
+    {
+        int cellX = (c - FIRST_GLYPH) % ATLAS_COLUMNS * GLYPH_SIZE;
+        int cellY = (c - FIRST_GLYPH) / ATLAS_COLUMNS * GLYPH_SIZE;
+        for (int row=0;row<GLYPH_SIZE; row++)
+            for (int bit=0;bit<GLYPH_SIZE; bit++)
+                if( font8x8[c - FIRST_GLYPH][row] & (1 << bit) )
+                    texels[(cellY + row) * ATLAS_WIDTH + cellX + bit] = 255;
+    }
+
+    glGenTextures(1, &atlasTexture);
+    glBindTexture(GL_TEXTURE_2D, atlasTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    //red only where GL has it, luminance reads back the same in .r
+    GLint internalFormat = (GLEW_VERSION_3_0 || GLEW_ARB_texture_rg) ? GL_R8 : GL_LUMINANCE;
+    GLenum format = (GLEW_VERSION_3_0 || GLEW_ARB_texture_rg) ? GL_RED : GL_LUMINANCE;
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, ATLAS_WIDTH, ATLAS_HEIGHT, 0,
+                 format, GL_UNSIGNED_BYTE, &texels[0]);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    //whole pixels only, glyphs are scaled by whole numbers
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+static void setAttributes()
+{
+    glBindBuffer(GL_ARRAY_BUFFER, textVbo);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex), (void*)offsetof(TextVertex,position));
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex), (void*)offsetof(TextVertex,texcoord));
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(TextVertex), (void*)offsetof(TextVertex,color));
+}
+
+bool textInit()
+{
+    GLuint vs = compileTextShader(GL_VERTEX_SHADER, textVertexShader);
+    GLuint fs = compileTextShader(GL_FRAGMENT_SHADER, textFragmentShader);
+    if( !vs || !fs )
+        return false;
+    textProgram = glCreateProgram();
+    glAttachShader(textProgram, vs);
+    glAttachShader(textProgram, fs);
+    glBindAttribLocation(textProgram, 0, "t_position");
+    glBindAttribLocation(textProgram, 1, "t_texcoord");
+    glBindAttribLocation(textProgram, 2, "t_color");
+    glLinkProgram(textProgram);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+    GLint linked;
+    glGetProgramiv(textProgram, GL_LINK_STATUS, &linked);
+    if( !linked )
+    {
+        printf("WARNING: Text shader failed to link\n");
+        glDeleteProgram(textProgram);
+        textProgram = 0;
+        return false;
+    }
+    loc_screenSize = glGetUniformLocation(textProgram, "screenSize");
+    loc_atlas = glGetUniformLocation(textProgram, "atlas");
+
+    bakeAtlas();
+    glGenBuffers(1, &textVbo);
+    vboSize = 0;
+
+    //with a vertex array object of its own the text's attribute state never
+    //touches the scene's (instance divisors in particular)
+    if( GLEW_VERSION_3_0 || GLEW_ARB_vertex_array_object )
+    {
+        glGenVertexArrays(1, &textVao);
+        glBindVertexArray(textVao);
+        setAttributes();
+        glBindVertexArray(0);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+}
+
+void textPrint(float x, float y, const char *text, int scale,
+               float r, float g, float b)
+{
+    if( lineCount == lines.size() )
+        lines.push_back(TextLine());
+    TextLine &line = lines[lineCount++];
+    line.x = x;
+    line.y = y;
+    line.scale = scale;
+    line.color[0] = (GLubyte)(r * 255.0f + 0.5f);
+    line.color[1] = (GLubyte)(g * 255.0f + 0.5f);
+    line.color[2] = (GLubyte)(b * 255.0f + 0.5f);
+    line.color[3] = 255;
+    line.text = text;
+}
+
+//Turns the queued lines into quads, on whole pixels so the glyphs stay sharp
+static void buildQuads(int width, int height)
+{
+    vertices.clear();
+    for (size_t l=0;l<lineCount; l++)
+    {
+        const TextLine &line = lines[l];
+        float size = (float)(GLYPH_SIZE * line.scale);
+        float penX = floorf((line.x + 1.0f) * 0.5f * width + 0.5f);
+        //the baseline sits one font pixel above the cell's bottom, which
+        //leaves room for descenders
+        float bottom = floorf((line.y + 1.0f) * 0.5f * height + 0.5f) - line.scale;
+        for (size_t i=0;i<line.text.size(); i++, penX += size)
+        {
+            int c = (unsigned char)line.text[i];
+            if( c <= FIRST_GLYPH || c > LAST_GLYPH )
+                continue;// spaces, newlines and anything outside the font
+            float u0 = (float)((c - FIRST_GLYPH) % ATLAS_COLUMNS * GLYPH_SIZE) / ATLAS_WIDTH;
+            float v0 = (float)((c - FIRST_GLYPH) / ATLAS_COLUMNS * GLYPH_SIZE) / ATLAS_HEIGHT;
+            float u1 = u0 + (float)GLYPH_SIZE / ATLAS_WIDTH;
+            float v1 = v0 + (float)GLYPH_SIZE / ATLAS_HEIGHT;
+            //atlas rows run top down, the screen bottom up
+            TextVertex corners[4] = {
+                { {penX, bottom}, {u0, v1}, {0, 0, 0, 0} },
+                { {penX + size, bottom}, {u1, v1}, {0, 0, 0, 0} },
+                { {penX + size, bottom + size}, {u1, v0}, {0, 0, 0, 0} },
+                { {penX, bottom + size}, {u0, v0}, {0, 0, 0, 0} } };
+            for (int k=0;k<4; k++)
+                memcpy(corners[k].color, line.color, sizeof(line.color));
+            static const int order[6] = {0, 1, 2, 0, 2, 3};
+            for (int k=0;k<6; k++)
+                vertices.push_back(corners[order[k]]);
+        }
+    }
+    lineCount = 0;
+}
+
+void textDraw(int width, int height)
+{
+    buildQuads(width, height);
+    if( vertices.empty() || textProgram == 0 )
+        return;
+
+    //one upload for the frame's text, the old storage is orphaned so this
+    //never waits for last frame's draw
+    size_t bytes = sizeof(TextVertex) * vertices.size();
+    glBindBuffer(GL_ARRAY_BUFFER, textVbo);
+    if( bytes > vboSize )
+        vboSize = bytes * 2;
+    glBufferData(GL_ARRAY_BUFFER, vboSize, NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, &vertices[0]);
+
+    glUseProgram(textProgram);
+    glUniform2f(loc_screenSize, (float)width, (float)height);
+    glUniform1i(loc_atlas, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, atlasTexture);
+    if( textVao )
+        glBindVertexArray(textVao);
+    else
+        setAttributes();
+
+    //on top of everything, blended by the glyph's coverage
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDrawArrays(GL_TRIANGLES, 0, vertices.size());
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+
+    if( textVao )
+    {
+        glBindVertexArray(0);
+    }
+    else
+    {
+        glDisableVertexAttribArray(0);
+        glDisableVertexAttribArray(1);
+        glDisableVertexAttribArray(2);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void textCleanUp()
+{
+    if( textVao )
+        glDeleteVertexArrays(1, &textVao);
+    glDeleteBuffers(1, &textVbo);
+    glDeleteTextures(1, &atlasTexture);
+    glDeleteProgram(textProgram);
+    textVao = textVbo = atlasTexture = textProgram = 0;
+    vboSize = 0;
+}
@@ -0,0 +1,184 @@
+#include "threadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Range
+{
+    size_t begin;
+    size_t end;
+};
+
+//One per thread, index 0 belongs to whoever calls parallelFor. A mutex per
+//queue is plenty here, each lock covers a push or pop of a whole range.
+struct WorkQueue
+{
+    std::mutex lock;
+    std::deque<Range> ranges;
+};
+
+static std::vector<std::thread> workers;
+static WorkQueue *queues = NULL;
+static unsigned int queueCount = 1;
+
+static const std::function<void(size_t, size_t)> *job = NULL;
+static size_t jobGrain = 1;
+static std::atomic<size_t> remaining(0);// indices not finished yet
+
+static std::mutex wakeLock;
+static std::condition_variable wake;
+static unsigned long generation = 0;// bumped for every parallelFor
+static bool stopping = false;
+
+static bool popBack(WorkQueue &queue, Range &range)
+{
+    std::lock_guard<std::mutex> guard(queue.lock);
+    if( queue.ranges.empty() )
+        return false;
+    range = queue.ranges.back();
+    queue.ranges.pop_back();
+    return true;
+}
+
+static bool stealFront(WorkQueue &queue, Range &range)
+{
+    std::lock_guard<std::mutex> guard(queue.lock);
+    if( queue.ranges.empty() )
+        return false;
+    range = queue.ranges.front();
+    queue.ranges.pop_front();
+    return true;
+}
+
+static void runRange(unsigned int self, Range range)
+{
+    //split until the piece is small, leaving the rest for thieves
+    while( range.end - range.begin > jobGrain )
+    {
+        size_t middle = range.begin + (range.end - range.begin) / 2;
+        Range back = { middle, range.end };
+        {
+            std::lock_guard<std::mutex> guard(queues[self].lock);
+            queues[self].ranges.push_back(back);
+        }
+        range.end = middle;
+    }
+    (*job)(range.begin, range.end);
+    remaining -= range.end - range.begin;
+}
+
+//Works until every index of the current job is done
+static void work(unsigned int self)
+{
+    unsigned int victim = self;
+    while( remaining > 0 )
+    {
+        Range range;
+        if( popBack(queues[self], range) )
+        {
+            runRange(self, range);
+            continue;
+        }
+
+        bool stole = false;
+        for( unsigned int i = 1; i < queueCount && !stole; i++ )
+        {
+            victim = (victim + 1) % queueCount;
+            if( victim != self )
+                stole = stealFront(queues[victim], range);
+        }
+        if( stole )
+            runRange(self, range);
+        else
+            std::this_thread::yield();// the last pieces are still running
+    }
+}
+
+static void workerMain(unsigned int self)
+{
+    unsigned long seen = 0;
+    while( true )
+    {
+        {
+            std::unique_lock<std::mutex> guard(wakeLock);
+            wake.wait(guard, [&]{ return stopping || generation != seen; });
+            if( stopping )
+                return;
+            seen = generation;
+        }
+        work(self);
+    }
+}
+
+void threadPoolStart(unsigned int count)
+{
+    threadPoolStop();
+    if( count == 0 )
+    {
+        unsigned int cores = std::thread::hardware_concurrency();
+        count = cores > 1 ? cores - 1 : 0;
+    }
+
+    stopping = false;
+    queueCount = count + 1;
+    queues = new WorkQueue[queueCount];
+    for( unsigned int i = 1; i <= count; i++ )
+        workers.push_back(std::thread(workerMain, i));
+}
+
+void threadPoolStop()
+{
+    {
+        std::lock_guard<std::mutex> guard(wakeLock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for( size_t i = 0; i < workers.size(); i++ )
+        workers[i].join();
+    workers.clear();
+    delete[] queues;
+    queues = NULL;
+    queueCount = 1;
+}
+
+unsigned int threadPoolSize()
+{
+    return queueCount;
+}
+
+void parallelFor(size_t begin, size_t end, size_t grain,
+                 const std::function<void(size_t, size_t)> &body)
+{
+    if( end <= begin )
+        return;
+    if( grain == 0 )
+        grain = 1;
+
+    //not worth waking anyone up for
+    if( workers.empty() || end - begin <= grain )
+    {
+        for( size_t first = begin; first < end; first += grain )
+            body(first, std::min(first + grain, end));
+        return;
+    }
+
+    job = &body;
+    jobGrain = grain;
+    remaining = end - begin;
+    {
+        std::lock_guard<std::mutex> guard(queues[0].lock);
+        Range range = { begin, end };
+        queues[0].ranges.push_back(range);
+    }
+    {
+        std::lock_guard<std::mutex> guard(wakeLock);
+        generation++;
+    }
+    wake.notify_all();
+
+    work(0);
+}
@@ -0,0 +1,28 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <stddef.h>
+#include <functional>
+
+//--Work stealing thread pool
+// parallelFor hands [begin, end) to the pool as one range. Whoever holds a
+// range bigger than the grain splits it, keeps the front half and pushes
+// the back half onto its own queue. Idle threads take from the back of
+// their own queue and steal from the front of everyone else's, so they
+// steal the biggest pieces still waiting. The calling thread works too and
+// returns once every index is done.
+//
+// body(first, last) is called on [first, last) pieces, at most grain long.
+// It must not call parallelFor itself.
+
+//Starts the workers, 0 means one per core (minus the caller)
+void threadPoolStart(unsigned int workers);
+void threadPoolStop();
+
+//Threads that take part in a parallelFor, the caller included
+unsigned int threadPoolSize();
+
+void parallelFor(size_t begin, size_t end, size_t grain,
+                 const std::function<void(size_t, size_t)> &body);
+
+#endif
@@ -0,0 +1,140 @@
+#include "transformBatch.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TRANSFORM_X86
+#include <immintrin.h>
+#endif
+
+typedef void (*TransformFunction)(const float *viewProjection, const float *models,
+                                  float *out, size_t count);
+
+//Plain loops, the reference the other paths are checked against
+static void transformScalar(const float *vp, const float *models, float *out, size_t count)
+{
+    for( size_t i = 0; i < count; i++ )
+    {
+        const float *model = models + 16 * i;
+        float *result = out + 16 * i;
+        for( int c = 0; c < 4; c++ )
+        {
+            for( int r = 0; r < 4; r++ )
+            {
+                result[4 * c + r] = vp[r] * model[4 * c] +
+                                    vp[4 + r] * model[4 * c + 1] +
+                                    vp[8 + r] * model[4 * c + 2] +
+                                    vp[12 + r] * model[4 * c + 3];
+            }
+        }
+    }
+}
+
+#ifdef TRANSFORM_X86
+//SSE is part of x86-64, so this one needs no target attribute
+static void transformSSE(const float *vp, const float *models, float *out, size_t count)
+{
+    __m128 v0 = _mm_loadu_ps(vp);
+    __m128 v1 = _mm_loadu_ps(vp + 4);
+    __m128 v2 = _mm_loadu_ps(vp + 8);
+    __m128 v3 = _mm_loadu_ps(vp + 12);
+    for( size_t i = 0; i < count; i++ )
+    {
+        const float *model = models + 16 * i;
+        float *result = out + 16 * i;
+        for( int c = 0; c < 4; c++ )
+        {
+            __m128 column = _mm_loadu_ps(model + 4 * c);
+            __m128 sum = _mm_mul_ps(v0, _mm_shuffle_ps(column, column, 0x00));
+            sum = _mm_add_ps(sum, _mm_mul_ps(v1, _mm_shuffle_ps(column, column, 0x55)));
+            sum = _mm_add_ps(sum, _mm_mul_ps(v2, _mm_shuffle_ps(column, column, 0xAA)));
+            sum = _mm_add_ps(sum, _mm_mul_ps(v3, _mm_shuffle_ps(column, column, 0xFF)));
+            _mm_storeu_ps(result + 4 * c, sum);
+        }
+    }
+}
+
+//Two columns per register: the low half works on one column, the high
+//half on the next, each with its own copy of viewProjection
+__attribute__((target("avx2,fma")))
+static void transformAVX2(const float *vp, const float *models, float *out, size_t count)
+{
+    __m256 v0 = _mm256_broadcast_ps((const __m128*)vp);
+    __m256 v1 = _mm256_broadcast_ps((const __m128*)(vp + 4));
+    __m256 v2 = _mm256_broadcast_ps((const __m128*)(vp + 8));
+    __m256 v3 = _mm256_broadcast_ps((const __m128*)(vp + 12));
+    for( size_t i = 0; i < count; i++ )
+    {
+        const float *model = models + 16 * i;
+        float *result = out + 16 * i;
+        for( int c = 0; c < 4; c += 2 )
+        {
+            __m256 columns = _mm256_loadu_ps(model + 4 * c);
+            __m256 sum = _mm256_mul_ps(v0, _mm256_permute_ps(columns, 0x00));
+            sum = _mm256_fmadd_ps(v1, _mm256_permute_ps(columns, 0x55), sum);
+            sum = _mm256_fmadd_ps(v2, _mm256_permute_ps(columns, 0xAA), sum);
+            sum = _mm256_fmadd_ps(v3, _mm256_permute_ps(columns, 0xFF), sum);
+            _mm256_storeu_ps(result + 4 * c, sum);
+        }
+    }
+}
+#endif
+
+bool transformPathSupported(TransformPath path)
+{
+    switch( path )
+    {
+        case TRANSFORM_SCALAR:
+            return true;
+#ifdef TRANSFORM_X86
+        case TRANSFORM_SSE:
+            return true;
+        case TRANSFORM_AVX2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+        default:
+            return false;
+    }
+}
+
+static TransformFunction transformFunction(TransformPath path)
+{
+#ifdef TRANSFORM_X86
+    if( path == TRANSFORM_AVX2 )
+        return transformAVX2;
+    if( path == TRANSFORM_SSE )
+        return transformSSE;
+#endif
+    return transformScalar;
+}
+
+TransformPath transformBestPath()
+{
+    for( int path = TRANSFORM_PATH_COUNT - 1; path > TRANSFORM_SCALAR; path-- )
+    {
+        if( transformPathSupported((TransformPath)path) )
+            return (TransformPath)path;
+    }
+    return TRANSFORM_SCALAR;
+}
+
+const char* transformPathName(TransformPath path)
+{
+    static const char *names[TRANSFORM_PATH_COUNT] = { "scalar", "sse", "avx2" };
+    return path < TRANSFORM_PATH_COUNT ? names[path] : "unknown";
+}
+
+void transformBatchWith(TransformPath path, const glm::mat4 &viewProjection,
+                        const glm::mat4 *models, glm::mat4 *out, size_t count)
+{
+    if( !transformPathSupported(path) )
+        path = TRANSFORM_SCALAR;
+    if( count > 0 )
+        transformFunction(path)(&viewProjection[0][0], &models[0][0][0], &out[0][0][0], count);
+}
+
+void transformBatch(const glm::mat4 &viewProjection, const glm::mat4 *models,
+                    glm::mat4 *out, size_t count)
+{
+    static TransformFunction function = transformFunction(transformBestPath());
+    if( count > 0 )
+        function(&viewProjection[0][0], &models[0][0][0], &out[0][0][0], count);
+}
@@ -0,0 +1,34 @@
+#ifndef TRANSFORMBATCH_H
+#define TRANSFORMBATCH_H
+
+#include <stddef.h>
+#include <glm/glm.hpp>
+
+//--Batched transforms
+// out[i] = viewProjection * models[i] for a whole array at once. The
+// matrices stay column major and packed like glm::mat4 (that is what the
+// GPU wants), each result column is the four viewProjection columns
+// scaled by the elements of a model column. SSE does a column at a time,
+// AVX2 two. The widest path the CPU supports is picked the first time
+// transformBatch is called.
+
+enum TransformPath
+{
+    TRANSFORM_SCALAR,
+    TRANSFORM_SSE,
+    TRANSFORM_AVX2,
+    TRANSFORM_PATH_COUNT
+};
+
+void transformBatch(const glm::mat4 &viewProjection, const glm::mat4 *models,
+                    glm::mat4 *out, size_t count);
+
+//For benchmarks and tests, false if the CPU (or the build) lacks the path
+bool transformPathSupported(TransformPath path);
+void transformBatchWith(TransformPath path, const glm::mat4 &viewProjection,
+                        const glm::mat4 *models, glm::mat4 *out, size_t count);
+
+TransformPath transformBestPath();
+const char* transformPathName(TransformPath path);
+
+#endif
@@ -0,0 +1,79 @@
+//Times every transformBatch path the CPU supports against the scalar one
+//usage: TransformBench [matrices] [repeats]
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include "transformBatch.h"
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static float randomFloat()
+{
+    return rand() / (float)RAND_MAX * 2.0f - 1.0f;
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? atol(argv[1]) : 10000;
+    int repeats = argc > 2 ? atoi(argv[2]) : 200;
+    if( count == 0 || repeats <= 0 )
+    {
+        printf("usage: %s [matrices] [repeats]\n", argv[0]);
+        return -1;
+    }
+
+    glm::mat4 viewProjection;
+    std::vector<glm::mat4> models(count);
+    for( int c = 0; c < 4; c++ )
+        for( int r = 0; r < 4; r++ )
+            viewProjection[c][r] = randomFloat();
+    for( size_t i = 0; i < count; i++ )
+        for( int c = 0; c < 4; c++ )
+            for( int r = 0; r < 4; r++ )
+                models[i][c][r] = randomFloat();
+
+    std::vector<glm::mat4> reference(count), out(count);
+    transformBatchWith(TRANSFORM_SCALAR, viewProjection, &models[0], &reference[0], count);
+
+    printf("%lu matrices, best of %d runs\n", (unsigned long)count, repeats);
+    double scalarTime = 0;
+    bool mismatch = false;
+    for( int path = 0; path < TRANSFORM_PATH_COUNT; path++ )
+    {
+        if( !transformPathSupported((TransformPath)path) )
+        {
+            printf("%-8s not supported\n", transformPathName((TransformPath)path));
+            continue;
+        }
+
+        double best = 1e30;
+        for( int run = 0; run < repeats; run++ )
+        {
+            Clock::time_point start = Clock::now();
+            transformBatchWith((TransformPath)path, viewProjection, &models[0], &out[0], count);
+            double seconds = std::chrono::duration_cast< std::chrono::duration<double> >(Clock::now() - start).count();
+            if( seconds < best )
+                best = seconds;
+        }
+        if( path == TRANSFORM_SCALAR )
+            scalarTime = best;
+
+        //fused multiply-add rounds differently, so allow a little slack
+        float error = 0;
+        for( size_t i = 0; i < count; i++ )
+            for( int c = 0; c < 4; c++ )
+                for( int r = 0; r < 4; r++ )
+                    error = fmaxf(error, fabsf(out[i][c][r] - reference[i][c][r]));
+
+        printf("%-8s %8.3f ms  %6.2f ns/matrix  %5.2fx  max error %g%s\n",
+               transformPathName((TransformPath)path), best * 1e3, best * 1e9 / count,
+               scalarTime / best, error, error > 1e-4f ? "  MISMATCH" : "");
+        if( error > 1e-4f )
+            mismatch = true;
+    }
+    printf("selected: %s\n", transformPathName(transformBestPath()));
+    //a kernel that gets the wrong answer fails the run
+    return mismatch ? 1 : 0;
+}
@@ -0,0 +1,65 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+//--Triple buffer
+// Hands the newest of a stream of values from one writer thread to one
+// reader thread without locks and without either side ever waiting. The
+// writer fills back() and publishes it. The reader calls acquire() and then
+// reads front() for as long as it likes. Values the reader never got to are
+// simply overwritten.
+//
+// Three slots: one the writer owns, one the reader owns, and one in the
+// middle that they swap theirs with. The middle index carries a flag that
+// says whether it holds something the reader has not seen yet.
+template <typename T>
+struct TripleBuffer
+{
+    TripleBuffer() : middle(1), backIndex(0), frontIndex(2)
+    {
+    }
+
+    //Writer side
+    T& back()
+    {
+        return slots[backIndex];
+    }
+
+    void publish()
+    {
+        //release so the reader sees everything written to the slot
+        backIndex = middle.exchange(backIndex | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    //Reader side
+    bool fresh() const
+    {
+        return (middle.load(std::memory_order_acquire) & FRESH) != 0;
+    }
+
+    //Swaps in the newest published value, false if there is none since
+    //the last call (front() stays as it was)
+    bool acquire()
+    {
+        if( !fresh() )
+            return false;
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    T& front()
+    {
+        return slots[frontIndex];
+    }
+
+private:
+    enum { INDEX = 3, FRESH = 4 };
+
+    T slots[3];
+    std::atomic<int> middle;
+    int backIndex;// only touched by the writer
+    int frontIndex;// only touched by the reader
+};
+
+#endif
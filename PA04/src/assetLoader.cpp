@@ -0,0 +1,198 @@
+#include "assetLoader.h"
+#include "meshLod.h"
+#include "meshOptimize.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <algorithm>
+#include <chrono>
+
+//Runs on the loader thread, no GL in here
+static void prepareModel(PreparedModel &model, std::string fileName, LoadOptions options)
+{
+    // A cache left by an earlier run needs no work at all
+    // otherwise parse the OBJ and leave a cache behind for next time
+    // (a cache without levels of detail or with a plainer triangle order
+    // than we want is no good)
+    unsigned int indexOrder = options.overdraw ? INDEX_ORDER_OVERDRAW : INDEX_ORDER_VERTEX_CACHE;
+    const Vertex *vertices;
+    GLuint vertexCount;
+    if( openMeshCache(fileName.c_str(), model.cached) &&
+        ((options.lods && model.cached.header->lodCount == 0) || model.cached.header->indexOrder < indexOrder) )
+        closeMeshCache(model.cached);
+    if( model.cached.header )
+    {
+        const MeshCacheHeader *header = model.cached.header;
+        printf("Vertex cache (cached): ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+               header->acmrBefore, header->acmrAfter, header->atvrBefore, header->atvrAfter);
+        for (uint32_t i=0;i<header->lodCount && (options.lods || i == 0); i++)
+        {
+            MeshLod lod = { header->lods[i].firstIndex, header->lods[i].indexCount, header->lods[i].error };
+            model.lods.push_back(lod);
+        }
+        model.boundsMin = glm::vec3(header->boundsMin[0], header->boundsMin[1], header->boundsMin[2]);
+        model.boundsMax = glm::vec3(header->boundsMax[0], header->boundsMax[1], header->boundsMax[2]);
+        model.sphereCenter = glm::vec3(header->sphereCenter[0], header->sphereCenter[1], header->sphereCenter[2]);
+        model.sphereRadius = header->sphereRadius;
+        vertices = model.cached.vertices;
+        vertexCount = header->vertexCount;
+        model.indexData = model.cached.indices;
+        model.indexCount = header->indexCount;
+        model.indexType = header->indexType;
+    }
+    else
+    {
+        Mesh &mesh = model.mesh;
+        if( !loadOBJ(fileName.c_str(), mesh) )
+            return;
+        if( options.lods )
+        {
+            buildLods(mesh, MAX_LODS);
+            for (unsigned int i=0;i<mesh.lods.size(); i++)
+                printf("LOD %u: %u triangles, error %g\n", i, mesh.lods[i].indexCount / 3, mesh.lods[i].error);
+            model.lods = mesh.lods;
+        }
+        //reorder the triangles for the vertex cache, once, the cache keeps it
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        optimizeMesh(mesh, options.overdraw);
+        printf("Vertex cache: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f (%.0f ms)\n",
+               mesh.acmrBefore, mesh.acmrAfter, mesh.atvrBefore, mesh.atvrAfter,
+               std::chrono::duration_cast< std::chrono::duration<float, std::milli> >(std::chrono::high_resolution_clock::now() - start).count());
+        writeMeshCache(fileName.c_str(), mesh);
+        model.boundsMin = mesh.boundsMin;
+        model.boundsMax = mesh.boundsMax;
+        model.sphereCenter = mesh.sphereCenter;
+        model.sphereRadius = mesh.sphereRadius;
+        vertices = mesh.vertices.data();
+        vertexCount = mesh.vertices.size();
+        model.indexCount = mesh.indices.size();
+        model.indexType = meshIndexType(mesh);
+        if( model.indexType == GL_UNSIGNED_SHORT )
+        {
+            //small meshes get 16 bit indices, half the memory
+            model.shortIndices.assign(mesh.indices.begin(), mesh.indices.end());
+            model.indexData = model.shortIndices.data();
+        }
+        else
+        {
+            model.indexData = mesh.indices.data();
+        }
+    }
+    model.indexBytes = (model.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint)) * (size_t)model.indexCount;
+
+    if( options.compact )
+    {
+        //half the size, quantized against the model's box
+        model.packed.resize(vertexCount);
+        packVertices(vertices, vertexCount, model.boundsMin, model.boundsMax, model.packed.data());
+        model.vertexData = model.packed.data();
+        model.vertexBytes = sizeof(PackedVertex) * (size_t)vertexCount;
+    }
+    else
+    {
+        model.vertexData = vertices;
+        model.vertexBytes = sizeof(Vertex) * (size_t)vertexCount;
+    }
+    model.ok = true;
+}
+
+static void loaderMain(AssetLoader *loader, std::string fileName, LoadOptions options)
+{
+    prepareModel(loader->model, fileName, options);
+    loader->prepared = true;
+}
+
+void loaderStart(AssetLoader &loader, const char *fileName, const LoadOptions &options)
+{
+    loader.model.ok = false;
+    loader.model.cached.header = NULL;
+    loader.model.cached.file.data = NULL;
+    loader.model.cached.file.size = 0;
+    loader.model.vertexData = loader.model.indexData = NULL;
+    loader.model.vertexBytes = loader.model.indexBytes = 0;
+    memset(&loader.batch, 0, sizeof(loader.batch));
+    loader.uploaded = 0;
+    loader.done = false;
+    loader.prepared = false;
+    loader.thread = std::thread(loaderMain, &loader, std::string(fileName), options);
+}
+
+bool loaderPrepared(const AssetLoader &loader)
+{
+    return loader.prepared;
+}
+
+void loaderWait(AssetLoader &loader)
+{
+    if( loader.thread.joinable() )
+        loader.thread.join();
+}
+
+bool loaderUpload(AssetLoader &loader, float budgetMs)
+{
+    if( loader.done )
+        return true;
+    PreparedModel &model = loader.model;
+    //always at least one slice a frame, even over budget
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    size_t total = model.vertexBytes + model.indexBytes;
+    do
+    {
+        //each buffer gets its storage just before its first slice, so the
+        //two allocations (not free either) count against the budget apart
+        size_t slice;
+        if( loader.uploaded < model.vertexBytes )
+        {
+            if( loader.batch.vbo == 0 )
+            {
+                loader.batch.count = model.indexCount;
+                loader.batch.indexType = model.indexType;
+                glGenBuffers(1, &loader.batch.vbo);
+                glBindBuffer(GL_ARRAY_BUFFER, loader.batch.vbo);
+                glBufferData(GL_ARRAY_BUFFER, model.vertexBytes, NULL, GL_STATIC_DRAW);
+            }
+            slice = std::min((size_t)UPLOAD_SLICE, model.vertexBytes - loader.uploaded);
+            glBindBuffer(GL_ARRAY_BUFFER, loader.batch.vbo);
+            glBufferSubData(GL_ARRAY_BUFFER, loader.uploaded, slice,
+                            (const char*)model.vertexData + loader.uploaded);
+        }
+        else
+        {
+            if( loader.batch.ibo == 0 )
+            {
+                glGenBuffers(1, &loader.batch.ibo);
+                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, loader.batch.ibo);
+                glBufferData(GL_ELEMENT_ARRAY_BUFFER, model.indexBytes, NULL, GL_STATIC_DRAW);
+            }
+            size_t offset = loader.uploaded - model.vertexBytes;
+            slice = std::min((size_t)UPLOAD_SLICE, model.indexBytes - offset);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, loader.batch.ibo);
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset, slice,
+                            (const char*)model.indexData + offset);
+        }
+        loader.uploaded += slice;
+    } while( loader.uploaded < total &&
+             std::chrono::duration_cast< std::chrono::duration<float, std::milli> >(std::chrono::high_resolution_clock::now() - start).count() < budgetMs );
+
+    loader.done = loader.uploaded >= total;
+    return loader.done;
+}
+
+float loaderProgress(const AssetLoader &loader)
+{
+    size_t total = loader.model.vertexBytes + loader.model.indexBytes;
+    return total > 0 ? (float)loader.uploaded / total : 1.0f;
+}
+
+void loaderCleanUp(AssetLoader &loader)
+{
+    loaderWait(loader);
+    if( loader.model.cached.header )
+        closeMeshCache(loader.model.cached);
+    //swap with empties, clear() keeps the memory
+    std::vector<Vertex>().swap(loader.model.mesh.vertices);
+    std::vector<GLuint>().swap(loader.model.mesh.indices);
+    std::vector<PackedVertex>().swap(loader.model.packed);
+    std::vector<GLushort>().swap(loader.model.shortIndices);
+    loader.model.vertexData = loader.model.indexData = NULL;
+}
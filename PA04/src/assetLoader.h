@@ -0,0 +1,82 @@
+#ifndef ASSETLOADER_H
+#define ASSETLOADER_H
+
+#include "objLoader.h"
+#include "meshCache.h"
+#include "meshStream.h"
+#include <thread>
+#include <atomic>
+#include <vector>
+
+//--Background model loading
+// The model is read on a thread of its own: the mesh cache is mapped, or
+// the OBJ is parsed, simplified and reordered, and the vertices are put in
+// the layout the GPU gets. Meanwhile the main thread compiles the shaders
+// and draws placeholder frames. Once the model is ready it goes up to the
+// GPU a slice at a time with glBufferSubData, at most a given number of
+// milliseconds a frame, so the window keeps drawing during a large upload.
+//
+// Streamed models (--stream) upload as they parse and are not loaded here.
+
+#define UPLOAD_BUDGET_MS 4.0f// GPU upload time per frame
+#define UPLOAD_SLICE (1 << 20)// bytes per glBufferSubData call
+
+struct LoadOptions
+{
+    bool lods;// build levels of detail
+    bool overdraw;// reorder for overdraw as well as the vertex cache
+    bool compact;// 12 byte vertices
+};
+
+//Everything the main thread needs, ready to upload
+struct PreparedModel
+{
+    bool ok;
+    CachedMesh cached;// the mapped cache, when there was one
+    Mesh mesh;// the parsed model otherwise
+    std::vector<PackedVertex> packed;// --compact vertices
+    std::vector<GLushort> shortIndices;// 16 bit copies of small index lists
+    const void *vertexData;
+    size_t vertexBytes;
+    const void *indexData;
+    size_t indexBytes;
+    GLuint indexCount;
+    GLenum indexType;
+    std::vector<MeshLod> lods;
+    glm::vec3 boundsMin, boundsMax;
+    glm::vec3 sphereCenter;
+    float sphereRadius;
+};
+
+struct AssetLoader
+{
+    std::thread thread;
+    std::atomic<bool> prepared;// set by the thread once model is filled in
+    PreparedModel model;
+    DrawBatch batch;// buffers being filled, complete once uploading is done
+    size_t uploaded;// bytes sent so far, vertices then indices
+    bool done;
+    AssetLoader() : prepared(false), uploaded(0), done(false) {}
+};
+
+//Starts reading a model on the loader thread
+void loaderStart(AssetLoader &loader, const char *fileName, const LoadOptions &options);
+
+//True once the thread has finished, check model.ok before uploading
+bool loaderPrepared(const AssetLoader &loader);
+
+//Waits for the thread to finish
+void loaderWait(AssetLoader &loader);
+
+//Uploads for at most budgetMs, call once a frame once the model is
+//prepared. True when the last slice is in and loader.batch can be drawn.
+bool loaderUpload(AssetLoader &loader, float budgetMs);
+
+//How much of the upload is done, 0 to 1
+float loaderProgress(const AssetLoader &loader);
+
+//Joins the thread and lets go of the host copy of the model (the
+//buffers in loader.batch belong to the caller once uploaded)
+void loaderCleanUp(AssetLoader &loader);
+
+#endif
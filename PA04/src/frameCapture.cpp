@@ -0,0 +1,397 @@
+#include "frameCapture.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum SlotState
+{
+    SLOT_FREE,
+    SLOT_READING,// the GPU is copying a frame into it
+    SLOT_WRITING// the writer thread has it
+};
+
+struct CaptureSlot
+{
+    GLuint buffer;
+    GLsync fence;
+    const unsigned char *mapped;// persistent mapping, NULL without one
+    std::vector<unsigned char> copy;// the frame copied out otherwise
+    const unsigned char *pixels;// what the writer reads, one or the other
+    unsigned long frame;
+    SlotState state;// guarded by lock
+};
+
+static bool capturing = false;
+static bool persistent = false;
+static int captureWidth = 0, captureHeight = 0;
+static size_t frameBytes = 0;
+static CaptureSlot slots[CAPTURE_SLOTS];
+static unsigned long framesRead = 0;// frames handed to the GPU
+static unsigned long framesCollected = 0;// frames handed to the writer
+static unsigned long framesWritten = 0;
+static unsigned long skipped = 0;// frames of the wrong size
+static unsigned long gpuWaits = 0;// frames that waited on a readback
+static unsigned long writerWaits = 0;// and on the writer
+
+//the writer thread's side
+static std::string pattern;
+static std::string fileFormat;// the PPM pattern with its conversion made long
+static bool signedFrame = false;// %d or %i, the frame goes in as a long
+static bool y4m = false;
+static FILE *stream = NULL;
+static std::thread writer;
+static std::mutex lock;
+static std::condition_variable changed;
+static bool stopping = false;
+
+//RGBA rows bottom up, the way glReadPixels leaves them
+static bool writePPM(const unsigned char *pixels, unsigned long frame)
+{
+    char fileName[1024];
+    if( signedFrame )
+        snprintf(fileName, sizeof(fileName), fileFormat.c_str(), (long)frame);
+    else
+        snprintf(fileName, sizeof(fileName), fileFormat.c_str(), frame);
+    FILE *file = fopen(fileName, "wb");
+    if( !file )
+        return false;
+    fprintf(file, "P6\n%d %d\n255\n", captureWidth, captureHeight);
+    std::vector<unsigned char> row(captureWidth * 3);
+    for (int y=captureHeight - 1;y>=0; y--)
+    {
+        const unsigned char *source = pixels + (size_t)y * captureWidth * 4;
+        for (int x=0;x<captureWidth; x++)
+        {
+            row[x * 3] = source[x * 4];
+            row[x * 3 + 1] = source[x * 4 + 1];
+            row[x * 3 + 2] = source[x * 4 + 2];
+        }
+        fwrite(&row[0], 1, row.size(), file);
+    }
+    return fclose(file) == 0;
+}
+
+//Full range BT.601 (what C420jpeg means) in fixed point. One pass over
+//pairs of rows: the four pixels of each 2x2 block give four lumas and,
+//averaged, one chroma pair. An odd last row or column repeats itself.
+static inline unsigned char lumaOf(const unsigned char *p)
+{
+    return (19595 * p[0] + 38470 * p[1] + 7471 * p[2] + 32768) >> 16;
+}
+
+static bool writeY4M(const unsigned char *pixels)
+{
+    int chromaWidth = (captureWidth + 1) / 2, chromaHeight = (captureHeight + 1) / 2;
+    static std::vector<unsigned char> luma, cb, cr;
+    luma.resize((size_t)captureWidth * captureHeight);
+    cb.resize((size_t)chromaWidth * chromaHeight);
+    cr.resize(cb.size());
+    size_t stride = (size_t)captureWidth * 4;
+    for (int cy=0;cy<chromaHeight; cy++)
+    {
+        //the frame is bottom up, the Y4M planes top down
+        int top = cy * 2, bottom = std::min(top + 1, captureHeight - 1);
+        const unsigned char *rowA = pixels + (captureHeight - 1 - top) * stride;
+        const unsigned char *rowB = pixels + (captureHeight - 1 - bottom) * stride;
+        unsigned char *lumaA = &luma[(size_t)top * captureWidth];
+        unsigned char *lumaB = &luma[(size_t)bottom * captureWidth];
+        unsigned char *cbRow = &cb[(size_t)cy * chromaWidth];
+        unsigned char *crRow = &cr[(size_t)cy * chromaWidth];
+        for (int cx=0;cx<chromaWidth; cx++)
+        {
+            int left = cx * 2 * 4, right = std::min(cx * 2 + 1, captureWidth - 1) * 4;
+            const unsigned char *a0 = rowA + left, *a1 = rowA + right;
+            const unsigned char *b0 = rowB + left, *b1 = rowB + right;
+            lumaA[left / 4] = lumaOf(a0);
+            lumaA[right / 4] = lumaOf(a1);
+            lumaB[left / 4] = lumaOf(b0);
+            lumaB[right / 4] = lumaOf(b1);
+            int r = a0[0] + a1[0] + b0[0] + b1[0];
+            int g = a0[1] + a1[1] + b0[1] + b1[1];
+            int b = a0[2] + a1[2] + b0[2] + b1[2];
+            //the sums are four pixels, so 18 fractional bits; pure blue and
+            //pure red round up to 256
+            cbRow[cx] = std::min((128 * 262144 - 11059 * r - 21709 * g + 32768 * b + 131072) >> 18, 255);
+            crRow[cx] = std::min((128 * 262144 + 32768 * r - 27439 * g - 5329 * b + 131072) >> 18, 255);
+        }
+    }
+    fputs("FRAME\n", stream);
+    fwrite(&luma[0], 1, luma.size(), stream);
+    fwrite(&cb[0], 1, cb.size(), stream);
+    fwrite(&cr[0], 1, cr.size(), stream);
+    return !ferror(stream);
+}
+
+//Writes the slots out in frame order until captureStop
+static void writerMain()
+{
+    unsigned int next = 0;
+    bool failed = false;
+    while( true )
+    {
+        CaptureSlot &slot = slots[next];
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            changed.wait(guard, [&]() { return slot.state == SLOT_WRITING || stopping; });
+            if( slot.state != SLOT_WRITING )
+                return;// stopping, and everything collected is written
+        }
+        //a full disk stops the writing, not the frames
+        if( !failed )
+        {
+            failed = !(y4m ? writeY4M(slot.pixels) : writePPM(slot.pixels, slot.frame));
+            if( failed )
+                printf("WARNING: Could not write captured frame %lu, capture stopped\n", slot.frame);
+            else
+                framesWritten++;
+        }
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            slot.state = SLOT_FREE;
+        }
+        changed.notify_all();
+        next = (next + 1) % CAPTURE_SLOTS;
+    }
+}
+
+//Hands the oldest frame still on the GPU to the writer once its fence has
+//passed, waiting for it when wait is set. False when it is not done yet.
+static bool collect(bool wait)
+{
+    CaptureSlot &slot = slots[framesCollected % CAPTURE_SLOTS];
+    if( framesCollected == framesRead )
+        return false;
+    GLenum result = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if( result == GL_TIMEOUT_EXPIRED )
+    {
+        if( !wait )
+            return false;
+        gpuWaits++;
+        do
+        {
+            result = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);// 1 s
+        } while( result == GL_TIMEOUT_EXPIRED );
+    }
+    glDeleteSync(slot.fence);
+    slot.fence = 0;
+
+    if( persistent )
+    {
+        slot.pixels = slot.mapped;
+    }
+    else
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        const void *data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes, GL_MAP_READ_BIT);
+        if( data )
+            memcpy(&slot.copy[0], data, frameBytes);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.pixels = &slot.copy[0];
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        slot.state = SLOT_WRITING;
+    }
+    changed.notify_all();
+    framesCollected++;
+    return true;
+}
+
+static bool createBuffers()
+{
+    for (int s=0;s<CAPTURE_SLOTS; s++)
+    {
+        CaptureSlot &slot = slots[s];
+        glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        if( persistent )
+        {
+            GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_PIXEL_PACK_BUFFER, frameBytes, NULL, flags | GL_CLIENT_STORAGE_BIT);
+            slot.mapped = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes, flags);
+            if( !slot.mapped )
+            {
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+                return false;
+            }
+        }
+        else
+        {
+            glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, NULL, GL_STREAM_READ);
+            slot.copy.resize(frameBytes);
+        }
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return true;
+}
+
+static void deleteBuffers()
+{
+    for (int s=0;s<CAPTURE_SLOTS; s++)
+    {
+        CaptureSlot &slot = slots[s];
+        if( slot.mapped )
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        if( slot.buffer )
+            glDeleteBuffers(1, &slot.buffer);
+        if( slot.fence )
+            glDeleteSync(slot.fence);
+        slot.buffer = 0;
+        slot.fence = 0;
+        slot.mapped = NULL;
+        slot.pixels = NULL;
+        std::vector<unsigned char>().swap(slot.copy);
+        slot.state = SLOT_FREE;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+//A PPM pattern numbers the files with exactly one integer conversion, which
+//is rewritten to take a long whatever length it was given with. False for
+//anything else, a stray %s would read garbage on the writer thread.
+static bool framePattern(const char *target)
+{
+    fileFormat.clear();
+    int conversions = 0;
+    for (const char *c = target; *c; c++)
+    {
+        fileFormat += *c;
+        if( *c != '%' )
+            continue;
+        if( c[1] == '%' )
+        {
+            fileFormat += *++c;
+            continue;
+        }
+        //flags, width and precision, but not a * that takes an argument
+        while( *++c && strchr("-+ #0123456789.", *c) )
+            fileFormat += *c;
+        while( *c && strchr("hlLqjzt", *c) )
+            c++;
+        if( !*c || !strchr("diouxX", *c) )
+            return false;
+        signedFrame = *c == 'd' || *c == 'i';
+        fileFormat += 'l';
+        fileFormat += *c;
+        conversions++;
+    }
+    return conversions == 1;
+}
+
+bool captureStart(const char *target, int width, int height, float fps)
+{
+    if( capturing || width <= 0 || height <= 0 )
+        return false;
+    if( !GLEW_ARB_sync || !GLEW_VERSION_3_2 )
+    {
+        printf("WARNING: Frame capture needs GL 3.2\n");
+        return false;
+    }
+    size_t length = strlen(target);
+    y4m = length > 4 && strcmp(target + length - 4, ".y4m") == 0;
+    if( y4m )
+    {
+        stream = fopen(target, "wb");
+        if( !stream )
+        {
+            printf("WARNING: Could not open %s for the capture\n", target);
+            return false;
+        }
+        //the rate as a fraction, --fixed-dt 0.0166667 is 60000:1000
+        fprintf(stream, "YUV4MPEG2 W%d H%d F%d:1000 Ip A1:1 C420jpeg XYSCSS=420JPEG\n",
+                width, height, (int)(fps * 1000.0f + 0.5f));
+    }
+    else if( !framePattern(target) )
+    {
+        printf("WARNING: The capture needs a .y4m file or a pattern with one number like frame%%05d.ppm, not %s\n", target);
+        return false;
+    }
+    pattern = target;
+
+    captureWidth = width;
+    captureHeight = height;
+    frameBytes = (size_t)width * height * 4;
+    framesRead = framesCollected = framesWritten = 0;
+    skipped = gpuWaits = writerWaits = 0;
+    persistent = GLEW_ARB_buffer_storage;
+    if( !createBuffers() )
+    {
+        //a driver can list the extension and still refuse the mapping
+        deleteBuffers();
+        persistent = false;
+        createBuffers();
+    }
+    stopping = false;
+    writer = std::thread(writerMain);
+    capturing = true;
+    return true;
+}
+
+void captureFrame(int width, int height)
+{
+    if( !capturing )
+        return;
+    if( width != captureWidth || height != captureHeight )
+    {
+        skipped++;
+        return;
+    }
+
+    //whatever the GPU has finished goes to the writer
+    while( collect(false) )
+        ;
+    //the slot this frame reads into is normally free by now, if not the
+    //GPU is a whole ring behind or the writer is
+    CaptureSlot &slot = slots[framesRead % CAPTURE_SLOTS];
+    if( framesRead - framesCollected == CAPTURE_SLOTS )
+        collect(true);
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        if( slot.state != SLOT_FREE )
+        {
+            writerWaits++;
+            changed.wait(guard, [&]() { return slot.state == SLOT_FREE; });
+        }
+    }
+
+    //only queues the copy, the pixels land in the buffer later
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    glReadPixels(0, 0, captureWidth, captureHeight, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.frame = framesRead++;
+    std::lock_guard<std::mutex> guard(lock);
+    slot.state = SLOT_READING;
+}
+
+void captureStop()
+{
+    if( !capturing )
+        return;
+    while( collect(true) )
+        ;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    changed.notify_all();
+    writer.join();
+    deleteBuffers();
+    if( stream )
+    {
+        fclose(stream);
+        stream = NULL;
+    }
+    capturing = false;
+    printf("Captured %lu of %lu frames to %s (waited on the GPU %lu times, on the writer %lu, %lu frames of another size skipped)\n",
+           framesWritten, framesRead, pattern.c_str(), gpuWaits, writerWaits, skipped);
+}
@@ -0,0 +1,51 @@
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+#include <GL/glew.h> // glew must be included before the main gl libs
+
+//--Frame timing
+// CPU time of update, render submission and the buffer swap for every
+// frame, plus GPU time from GL_TIME_ELAPSED queries. The queries live in a
+// small ring and are only read once the GPU reports them done, so reading
+// them never stalls the pipeline (the GPU numbers lag a few frames).
+
+enum FrameStage
+{
+    STAGE_UPDATE,
+    STAGE_RENDER,
+    STAGE_SWAP,
+    STAGE_COUNT
+};
+
+//Milliseconds, smoothed over the last frames for display
+struct FrameTiming
+{
+    float stage[STAGE_COUNT];
+    float gpu;// negative when the driver has no timer queries
+    float frame;// start of one frame to the start of the next
+    unsigned int visible;// objects drawn last frame (not smoothed)
+    unsigned int culled;// objects the frustum test threw away
+};
+
+//Call once the GL context exists, csvFileName may be NULL
+void frameStatsInit(const char *csvFileName);
+
+void frameStatsBegin(FrameStage stage);
+void frameStatsEnd(FrameStage stage);
+
+//Bracket the GL commands of a frame
+void frameStatsGpuBegin();
+void frameStatsGpuEnd();
+
+//How many objects this frame drew and culled
+void frameStatsCounts(unsigned int visible, unsigned int culled);
+
+//Call after the swap, closes the frame and collects finished queries
+void frameStatsEndFrame();
+
+const FrameTiming& frameStatsAverage();
+
+//Writes out whatever is still pending and closes the CSV
+void frameStatsCleanUp();
+
+#endif
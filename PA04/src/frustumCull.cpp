@@ -0,0 +1,115 @@
+#include "frustumCull.h"
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CULL_SSE
+#include <immintrin.h>
+#endif
+
+void frustumFromMatrix(const glm::mat4 &viewProjection, Frustum &frustum)
+{
+    //glm is column major, so row r is m[0][r], m[1][r], m[2][r], m[3][r]
+    const glm::mat4 &m = viewProjection;
+    glm::vec4 rows[4];
+    for( int r = 0; r < 4; r++ )
+        rows[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+
+    frustum.planes[0] = rows[3] + rows[0];
+    frustum.planes[1] = rows[3] - rows[0];
+    frustum.planes[2] = rows[3] + rows[1];
+    frustum.planes[3] = rows[3] - rows[1];
+    frustum.planes[4] = rows[3] + rows[2];
+    frustum.planes[5] = rows[3] - rows[2];
+
+    //unit normals, so the plane distance can be compared to a radius
+    for( int p = 0; p < 6; p++ )
+    {
+        glm::vec4 &plane = frustum.planes[p];
+        float length = sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        if( length > 0.0f )
+            plane = plane * (1.0f / length);
+    }
+}
+
+//The sphere under one model matrix, the radius grows with the largest scale
+static void worldSphere(const glm::mat4 &model, const glm::vec3 &center, float radius,
+                        glm::vec3 &worldCenter, float &worldRadius)
+{
+    glm::vec4 position = model * glm::vec4(center, 1.0f);
+    worldCenter = glm::vec3(position.x, position.y, position.z);
+
+    float scale = 0.0f;
+    for( int c = 0; c < 3; c++ )
+    {
+        const glm::vec4 &axis = model[c];
+        scale = fmaxf(scale, axis.x * axis.x + axis.y * axis.y + axis.z * axis.z);
+    }
+    worldRadius = radius * sqrtf(scale);
+}
+
+static bool sphereVisible(const Frustum &frustum, const glm::vec3 &center, float radius)
+{
+    for( int p = 0; p < 6; p++ )
+    {
+        const glm::vec4 &plane = frustum.planes[p];
+        if( plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius )
+            return false;
+    }
+    return true;
+}
+
+size_t cullSpheres(const Frustum &frustum, const glm::mat4 *models, size_t count,
+                   const glm::vec3 &center, float radius, unsigned int *visible)
+{
+    size_t visibleCount = 0;
+    size_t i = 0;
+
+#ifdef CULL_SSE
+    //four spheres at a time, laid out as x, y, z and radius registers
+    for( ; i + 4 <= count; i += 4 )
+    {
+        float x[4], y[4], z[4], r[4];
+        for( int j = 0; j < 4; j++ )
+        {
+            glm::vec3 worldCenter;
+            worldSphere(models[i + j], center, radius, worldCenter, r[j]);
+            x[j] = worldCenter.x;
+            y[j] = worldCenter.y;
+            z[j] = worldCenter.z;
+        }
+        __m128 xs = _mm_loadu_ps(x);
+        __m128 ys = _mm_loadu_ps(y);
+        __m128 zs = _mm_loadu_ps(z);
+        __m128 negativeRadii = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(r));
+
+        __m128 outside = _mm_setzero_ps();
+        for( int p = 0; p < 6; p++ )
+        {
+            const glm::vec4 &plane = frustum.planes[p];
+            __m128 distance = _mm_add_ps(_mm_mul_ps(xs, _mm_set1_ps(plane.x)),
+                                         _mm_mul_ps(ys, _mm_set1_ps(plane.y)));
+            distance = _mm_add_ps(distance, _mm_mul_ps(zs, _mm_set1_ps(plane.z)));
+            distance = _mm_add_ps(distance, _mm_set1_ps(plane.w));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negativeRadii));
+        }
+
+        int outsideMask = _mm_movemask_ps(outside);
+        for( int j = 0; j < 4; j++ )
+        {
+            if( !(outsideMask & (1 << j)) )
+                visible[visibleCount++] = i + j;
+        }
+    }
+#endif
+
+    //whatever is left over (everything without SSE)
+    for( ; i < count; i++ )
+    {
+        glm::vec3 worldCenter;
+        float worldRadius;
+        worldSphere(models[i], center, radius, worldCenter, worldRadius);
+        if( sphereVisible(frustum, worldCenter, worldRadius) )
+            visible[visibleCount++] = i;
+    }
+    return visibleCount;
+}
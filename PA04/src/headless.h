@@ -0,0 +1,53 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <GL/glew.h> // glew must be included before the main gl libs
+
+//--Headless rendering
+// Runs the program without a window: the GL context comes from EGL
+// (surfaceless when Mesa offers it, otherwise a small pbuffer) and every
+// frame is drawn into an offscreen framebuffer. Mesa's llvmpipe driver
+// makes this work on machines with no display and no GPU.
+
+extern bool headless;// true once --headless has been given
+
+//Creates the offscreen context, call it in place of glutCreateWindow
+bool headlessInit();
+
+//--Scenario checks
+// A headless run can check itself against an earlier one: the last frame
+// is compared with a golden image and the frame time percentiles with a
+// baseline. A golden image or baseline that does not exist yet is written
+// by the run instead, which makes that run the reference.
+struct HeadlessChecks
+{
+    int warmup;// frames drawn before timing starts
+    const char *goldenFile;// binary PPM of the last frame
+    int tolerance;// how far a channel may be off and still match (0-255)
+    float maxMismatch;// percent of pixels allowed past the tolerance
+    const char *baselineFile;// p50 p95 p99 in ms, one line of text
+    float slowdown;// percent p50 and p95 may be over the baseline
+};
+extern HeadlessChecks headlessChecks;
+
+//Takes argv[i] (and its value, moving i past it) if it is one of
+//--warmup N, --golden file, --tolerance N, --max-mismatch percent,
+//--baseline file or --slowdown percent
+bool headlessOption(int argc, char **argv, int &i);
+
+//Draws frames by calling update and render directly, then prints timing
+//stats. Call it in place of glutMainLoop once glew is initialized.
+//False when a scenario check failed.
+bool headlessRun(int width, int height, int frames,
+                 void (*update)(), void (*render)());
+
+//Stands in for glutSwapBuffers, waits for the frame to finish
+void headlessSwapBuffers();
+
+void headlessCleanUp();
+
+//glewInit looks for a GLX display once it has loaded the GL functions,
+//which fails on an EGL context even though nothing is missing
+bool glewStatusOk(GLenum status);
+
+#endif
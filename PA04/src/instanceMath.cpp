@@ -0,0 +1,29 @@
+#include "instanceMath.h"
+#include <math.h>
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+
+void placeModels(const glm::vec3 *offsets, size_t count, float angle, float scale,
+                 glm::mat4 *models)
+{
+    for (size_t i=0;i<count; i++)
+    {
+        models[i] = glm::translate(glm::mat4(1.0f), offsets[i]);
+        models[i] = glm::rotate(models[i], angle, glm::vec3(0, 1, 0));
+        models[i] = glm::scale(models[i], glm::vec3(scale,scale,scale));
+    }
+}
+
+float pixelsPerUnit(const glm::mat4 &view, const glm::mat4 &projection,
+                    const glm::mat4 &model, const glm::vec3 &center, int height)
+{
+    //the largest axis scale covers any rotation
+    glm::vec4 viewCenter = view * model * glm::vec4(center, 1.0f);
+    float scale = 0.0f;
+    for (int c=0;c<3; c++)
+    {
+        const glm::vec4 &axis = model[c];
+        scale = std::max(scale, axis.x * axis.x + axis.y * axis.y + axis.z * axis.z);
+    }
+    return projection[1][1] * height * 0.5f * sqrtf(scale) / std::max(-viewCenter.z, 0.01f);
+}
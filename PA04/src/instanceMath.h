@@ -0,0 +1,22 @@
+#ifndef INSTANCEMATH_H
+#define INSTANCEMATH_H
+
+#include <stddef.h>
+#include <glm/glm.hpp>
+
+//--Per copy math
+// What update() and drawModels() work out for every copy of the model each
+// frame. Kept out of main.cpp so LoaderBench can time it without a GL
+// context.
+
+//Model matrix of each copy: moved to its place on the grid, then the
+//spin (degrees about y) and scale every copy shares
+void placeModels(const glm::vec3 *offsets, size_t count, float angle, float scale,
+                 glm::mat4 *models);
+
+//How many pixels one model unit covers at a copy, for selectLod. center is
+//the model's bounding sphere center and height the viewport's in pixels.
+float pixelsPerUnit(const glm::mat4 &view, const glm::mat4 &projection,
+                    const glm::mat4 &model, const glm::vec3 &center, int height);
+
+#endif
@@ -0,0 +1,323 @@
+//Times the CPU hot paths of the loader and the per frame math, no GL needed
+//usage: LoaderBench [--sizes 1K,10K,100K,1M] [--repeats 10] [--warmup 2]
+//                   [--copies 10000] [--dir /tmp] [--json file]
+//Synthetic OBJ grids with the given triangle counts are written to --dir
+//the first time and reused after that. --json - puts the JSON on stdout
+//and the table on stderr.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "objLoader.h"
+#include "shaderFile.h"
+#include "frustumCull.h"
+#include "meshLod.h"
+#include "instanceMath.h"
+
+typedef std::chrono::high_resolution_clock Clock;
+
+struct BenchResult
+{
+    std::string name;
+    unsigned long size;// items per run
+    const char *unit;
+    double min, median, mean, max, stddev;// ms
+};
+
+static int repeats = 10;
+static int warmup = 2;
+static std::vector<BenchResult> results;
+static FILE *table = stdout;
+static volatile double sink;// keeps the optimizer from dropping the work
+
+//Runs work warmup times unmeasured and then repeats times, and keeps the
+//spread of those runs. items is how many units one run handles.
+template <class Work>
+static void bench(const std::string &name, unsigned long items, const char *unit, Work work)
+{
+    for (int i=0;i<warmup; i++)
+        work();
+    std::vector<double> samples;
+    for (int i=0;i<repeats; i++)
+    {
+        Clock::time_point start = Clock::now();
+        work();
+        samples.push_back(std::chrono::duration_cast< std::chrono::duration<double, std::milli> >(Clock::now() - start).count());
+    }
+    std::sort(samples.begin(), samples.end());
+
+    BenchResult result;
+    result.name = name;
+    result.size = items;
+    result.unit = unit;
+    result.min = samples.front();
+    result.max = samples.back();
+    size_t middle = samples.size() / 2;
+    result.median = samples.size() % 2 ? samples[middle] : (samples[middle - 1] + samples[middle]) * 0.5;
+    result.mean = 0;
+    for (size_t i=0;i<samples.size(); i++)
+        result.mean += samples[i];
+    result.mean /= samples.size();
+    result.stddev = 0;
+    for (size_t i=0;i<samples.size(); i++)
+        result.stddev += (samples[i] - result.mean) * (samples[i] - result.mean);
+    result.stddev = sqrt(result.stddev / samples.size());
+    results.push_back(result);
+
+    fprintf(table, "%-20s %10lu %-9s median %10.3f ms  min %10.3f  max %10.3f  %9.2f ns/%s\n",
+            name.c_str(), items, unit, result.median, result.min, result.max,
+            result.median * 1e6 / items, unit);
+    fflush(table);
+}
+
+//1K, 50M and plain numbers
+static unsigned long parseCount(const char *text)
+{
+    char *end;
+    double value = strtod(text, &end);
+    if( *end == 'K' || *end == 'k' )
+        value *= 1e3;
+    else if( *end == 'M' || *end == 'm' )
+        value *= 1e6;
+    return (unsigned long)value;
+}
+
+//A flat grid with exactly triangles triangles, two to a square. Writing
+//goes through one buffer, the 50M triangle file is a couple of GB.
+static bool writeGrid(const char *fileName, unsigned long triangles)
+{
+    FILE *file = fopen(fileName, "wb");
+    if( !file )
+        return false;
+    unsigned long squares = (triangles + 1) / 2;
+    unsigned long side = (unsigned long)ceil(sqrt((double)squares));
+    std::vector<char> buffer(1 << 20);
+    size_t used = 0;
+    char line[96];
+    fprintf(file, "# LoaderBench grid, %lu triangles\n", triangles);
+    for (unsigned long z=0;z<=side; z++)
+    {
+        for (unsigned long x=0;x<=side; x++)
+        {
+            int length = snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n",
+                                  x / (double)side - 0.5, 0.05 * sin(x * 0.1) * cos(z * 0.1), z / (double)side - 0.5);
+            if( used + length > buffer.size() )
+            {
+                fwrite(&buffer[0], 1, used, file);
+                used = 0;
+            }
+            memcpy(&buffer[used], line, length);
+            used += length;
+        }
+    }
+    unsigned long written = 0;
+    for (unsigned long s=0;s<squares; s++)
+    {
+        //1 based, the square's corners
+        unsigned long a = (s / side) * (side + 1) + s % side + 1;
+        unsigned long b = a + 1, c = a + side + 1, d = c + 1;
+        int length = snprintf(line, sizeof(line), "f %lu %lu %lu\n", a, c, b);
+        if( ++written < triangles )
+            length += snprintf(line + length, sizeof(line) - length, "f %lu %lu %lu\n", b, c, d);
+        written++;
+        if( used + length > buffer.size() )
+        {
+            fwrite(&buffer[0], 1, used, file);
+            used = 0;
+        }
+        memcpy(&buffer[used], line, length);
+        used += length;
+    }
+    fwrite(&buffer[0], 1, used, file);
+    return fclose(file) == 0;
+}
+
+static bool fileExists(const char *fileName)
+{
+    struct stat info;
+    return stat(fileName, &info) == 0;
+}
+
+static void writeJson(FILE *file)
+{
+    fprintf(file, "{\n  \"benchmark\": \"LoaderBench\",\n  \"repeats\": %d,\n  \"warmup\": %d,\n  \"results\": [\n",
+            repeats, warmup);
+    for (size_t i=0;i<results.size(); i++)
+    {
+        const BenchResult &r = results[i];
+        fprintf(file, "    {\"name\": \"%s\", \"size\": %lu, \"unit\": \"%s\", "
+                      "\"median_ms\": %.6f, \"min_ms\": %.6f, \"max_ms\": %.6f, \"mean_ms\": %.6f, \"stddev_ms\": %.6f, "
+                      "\"ns_per_item\": %.4f}%s\n",
+                r.name.c_str(), r.size, r.unit, r.median, r.min, r.max, r.mean, r.stddev,
+                r.median * 1e6 / r.size, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<unsigned long> sizes;
+    unsigned long copies = 10000;
+    std::string dir = "/tmp";
+    const char *jsonFileName = NULL;
+    for (int i=1;i<argc; i++)
+    {
+        if( strcmp(argv[i], "--sizes") == 0 && i + 1 < argc )
+        {
+            for (char *size=strtok(argv[++i], ",");size; size=strtok(NULL, ","))
+                sizes.push_back(parseCount(size));
+        }
+        else if( strcmp(argv[i], "--repeats") == 0 && i + 1 < argc )
+            repeats = atoi(argv[++i]);
+        else if( strcmp(argv[i], "--warmup") == 0 && i + 1 < argc )
+            warmup = atoi(argv[++i]);
+        else if( strcmp(argv[i], "--copies") == 0 && i + 1 < argc )
+            copies = parseCount(argv[++i]);
+        else if( strcmp(argv[i], "--dir") == 0 && i + 1 < argc )
+            dir = argv[++i];
+        else if( strcmp(argv[i], "--json") == 0 && i + 1 < argc )
+            jsonFileName = argv[++i];
+        else
+        {
+            printf("usage: %s [--sizes 1K,10K,100K,1M] [--repeats N] [--warmup N] "
+                   "[--copies N] [--dir path] [--json file|-]\n", argv[0]);
+            return -1;
+        }
+    }
+    if( sizes.empty() )
+    {
+        sizes.push_back(1000);
+        sizes.push_back(10000);
+        sizes.push_back(100000);
+        sizes.push_back(1000000);
+    }
+    if( repeats <= 0 || warmup < 0 || copies == 0 )
+    {
+        printf("repeats and copies must be at least 1\n");
+        return -1;
+    }
+    if( jsonFileName && strcmp(jsonFileName, "-") == 0 )
+        table = stderr;
+
+    //--loadOBJ, the whole parse of a file already in the page cache
+    for (size_t s=0;s<sizes.size(); s++)
+    {
+        if( sizes[s] == 0 )
+            continue;
+        char fileName[512];
+        snprintf(fileName, sizeof(fileName), "%s/loaderbench_%lu.obj", dir.c_str(), sizes[s]);
+        if( !fileExists(fileName) )
+        {
+            fprintf(stderr, "writing %s\n", fileName);
+            if( !writeGrid(fileName, sizes[s]) )
+            {
+                fprintf(stderr, "could not write %s\n", fileName);
+                return -1;
+            }
+        }
+        bench("loadOBJ", sizes[s], "triangle", [&]()
+        {
+            Mesh mesh;
+            loadOBJ(fileName, mesh);
+            sink = mesh.indices.size();
+        });
+    }
+
+    //--split, the old string tokenizer, on face lines with and without slashes
+    const int splitCalls = 100000;
+    std::vector<unsigned int> elems;
+    std::string plainFace = "12 345 6789";
+    std::string slashFace = "12/1/12 345/2/345 6789/3/6789";
+    bench("split plain", splitCalls, "call", [&]()
+    {
+        for (int i=0;i<splitCalls; i++)
+            split(plainFace, elems);
+        sink = elems.size();
+    });
+    bench("split slashes", splitCalls, "call", [&]()
+    {
+        for (int i=0;i<splitCalls; i++)
+            split(slashFace, elems);
+        sink = elems.size();
+    });
+
+    //--loadShaderFromFile, the real shader when run from bin, else a stand in
+    std::string shaderName = "assets/shaders/vs.txt";
+    if( !fileExists(shaderName.c_str()) )
+    {
+        shaderName = dir + "/loaderbench_shader.txt";
+        FILE *file = fopen(shaderName.c_str(), "wb");
+        if( !file )
+        {
+            fprintf(stderr, "could not write %s\n", shaderName.c_str());
+            return -1;
+        }
+        for (int i=0;i<64; i++)
+            fprintf(file, "uniform mat4 matrix%d; // a line of a made up shader\n", i);
+        fclose(file);
+    }
+    const int shaderCalls = 1000;
+    bench("loadShaderFromFile", shaderCalls, "call", [&]()
+    {
+        for (int i=0;i<shaderCalls; i++)
+        {
+            const char *source = loadShaderFromFile(shaderName.c_str());
+            sink = source[0];
+            delete[] source;
+        }
+    });
+
+    //--the per copy math of update() and drawModels(), copies on a grid
+    //going away from the camera the same way placeCopies lays them out
+    std::vector<glm::vec3> offsets(copies);
+    std::vector<glm::mat4> models(copies);
+    int side = (int)ceil(sqrt((double)copies));
+    for (unsigned long i=0;i<copies; i++)
+        offsets[i] = glm::vec3(((i % side) - (side - 1) / 2.0f) * 1.5f, 0.0f, (i / side) * 1.5f);
+    float angle = 0;
+    bench("placeModels", copies, "copy", [&]()
+    {
+        angle += 1.0f;
+        placeModels(&offsets[0], copies, angle, 1.0f, &models[0]);
+        sink = models[copies - 1][3][2];
+    });
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0, 8.0, -16.0), glm::vec3(0.0, 0.0, 0.0), glm::vec3(0.0, 1.0, 0.0));
+    glm::mat4 projection = glm::perspective(45.0f, 640.0f / 480.0f, 0.01f, 100.0f);
+    MeshLod lods[4] = { {0, 0, 0.0f}, {0, 0, 0.002f}, {0, 0, 0.01f}, {0, 0, 0.05f} };
+    std::vector<unsigned int> visible(copies), instanceLods(copies, 0);
+    bench("cull and pick lods", copies, "copy", [&]()
+    {
+        Frustum frustum;
+        frustumFromMatrix(projection * view, frustum);
+        size_t count = cullSpheres(frustum, &models[0], copies, glm::vec3(0.0f), 0.87f, &visible[0]);
+        for (size_t i=0;i<count; i++)
+        {
+            unsigned int index = visible[i];
+            float pixels = pixelsPerUnit(view, projection, models[index], glm::vec3(0.0f), 480);
+            instanceLods[index] = selectLod(lods, 4, pixels, instanceLods[index]);
+        }
+        sink = count;
+    });
+
+    if( jsonFileName )
+    {
+        FILE *json = strcmp(jsonFileName, "-") == 0 ? stdout : fopen(jsonFileName, "w");
+        if( !json )
+        {
+            fprintf(stderr, "could not write %s\n", jsonFileName);
+            return -1;
+        }
+        writeJson(json);
+        if( json != stdout )
+            fclose(json);
+    }
+    return 0;
+}
@@ -2,112 +2,248 @@
 #include <GL/glut.h> // doing otherwise causes compiler shouting
 #include <iostream>
 #include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
 #include <chrono>
+#include <algorithm>
 #include <vector>
 #include <fstream>
-#include <sstream>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp> //Makes passing matrices to shaders easier
-
-
-//--Data types
-//This object will define the attributes of a vertex(position, color, etc...)
-struct Vertex
-{
-    GLfloat position[3];
-    GLfloat color[3];
-};
-
-//GLUT Fonts
-  void * glutFonts[7] = {
-  GLUT_BITMAP_9_BY_15,
-  GLUT_BITMAP_8_BY_13,
-  GLUT_BITMAP_TIMES_ROMAN_10,
-  GLUT_BITMAP_TIMES_ROMAN_24,
-  GLUT_BITMAP_HELVETICA_10,
-  GLUT_BITMAP_HELVETICA_12,
-  GLUT_BITMAP_HELVETICA_18 };
+#include "objLoader.h"
+#include "shaderFile.h"
+#include "meshStream.h"
+#include "headless.h"
+#include "frameStats.h"
+#include "programCache.h"
+#include "shaderReload.h"
+#include "streamRing.h"
+#include "textOverlay.h"
+#include "frameCapture.h"
+#include "framePacer.h"
+#include "assetLoader.h"
+#include "frustumCull.h"
+#include "meshLod.h"
+#include "instanceMath.h"
+
+
+//Where the linked shader program is kept between runs
+#define PROGRAM_CACHE_FILE "assets/shaders/program.bin"
 
 //--Evil Global variables
 //Just for this example!
 int w = 640, h = 480;// Window size
 int ROTATION_FLAG = 0;
+bool SHOW_STATS = true;// timing overlay, toggled with h
+char *csvFileName = NULL;// per frame timings go here with --csv
+char *captureTarget = NULL;// every frame is recorded here with --capture
 int SPIN_MOD = 1;
 int PLANET_MOD = 1;
 float scaleFactor=1;
 float SPEED_MOD = 3;
+bool PAUSED = false;// p stops the model where it is
+bool windowVisible = true;// a hidden window does not draw
+float targetFps = 60;// frames a second the window is paced to, 0 for as fast as it goes (--fps)
+bool onDemand = false;// only draw when something changed (--on-demand)
+bool idleStopped = false;// the idle callback is off until input asks for a frame
 GLuint program;// The GLSL program handle
-GLuint vbo_geometry;// VBO handle for our geometry
-unsigned int numVertices=36; 
+std::vector<DrawBatch> batches;// Buffers holding our geometry, usually just one
+AssetLoader loader;// reads the model in the background
+bool modelReady = false;// uploaded and the copies are placed
+StreamRing frameRing;// this frame's FrameData block and model matrices
+bool instancing = false;// draw every copy with one instanced call per batch
+bool frameBlock = false;// the program takes its per frame uniforms as a block
+GLint uniformAlignment = 256;// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+int instanceCount = 1;// copies of the model (--instances)
+float fixedStep = 0;// --fixed-dt, what getDT returns every frame, 0 for real time
 char *objFileName="assets/models/table.obj";
-//uniform locations
-GLint loc_mvpmat;// Location of the modelviewprojection matrix in the shader
+bool compactVertices = false;// 12 byte vertices with quantized positions (--compact)
+bool useLods = false;// build and draw levels of detail (--lod)
+bool reduceOverdraw = false;// sort triangle clusters front facing first (--overdraw)
+bool streamModel = false;// Load the model a window at a time (--stream)
+StreamOptions streamOptions = { 256 << 20, 512 << 20 };// --mem-cap, --max-buffer in MB
+//Per frame uniforms, laid out like the FrameData block in vs.txt (std140)
+struct FrameData
+{
+    glm::mat4 vpMatrix;
+    glm::vec4 positionScale;
+    glm::vec4 positionOffset;
+};
+#define FRAME_DATA_BINDING 0// uniform buffer binding point of the block
+GLuint frameDataBuffer = 0;// the block's own buffer when there is no ring
+
+//uniform locations, when the program has no FrameData block
+GLint loc_vpmat;// Location of the viewprojection matrix in the shader
+GLint loc_positionScale;// maps compact positions back into the model's box
+GLint loc_positionOffset;
 
 //attribute locations
 GLint loc_position;
 GLint loc_color;
+GLint loc_model;// a mat4 attribute, takes 4 locations starting here
 
 //Multiple models
 std::vector<glm::mat4> models;
+std::vector<glm::vec3> modelOffsets;// where each copy sits
+glm::vec3 modelMin, modelMax;// bounds of the loaded model
+glm::vec3 modelCenter;// bounding sphere of the loaded model
+float modelRadius;
+std::vector<unsigned int> visibleIndices;// models that survived culling
+std::vector<glm::mat4> visibleModels;// and their matrices, packed for drawing
+std::vector<MeshLod> lods;// levels of detail of the loaded model, empty without --lod
+std::vector<unsigned char> instanceLods;// level each copy was drawn with last
+std::vector<unsigned int> lodStarts;// where each level's copies start in visibleModels
+unsigned long trianglesDrawn = 0;
 
 //transform matrices
 glm::mat4 model;//obj->world each object should have its own model matrix
 glm::mat4 view;//world->eye
 glm::mat4 projection;//eye->clip
-glm::mat4 mvp;//premultiplied modelviewprojection
+glm::mat4 vp;//premultiplied viewprojection
 
 //--GLUT Callbacks
 void render();
 void update();
+void idle();
+void visibility(int state);
 void reshape(int n_w, int n_h);
 void keyboard(unsigned char key, int x_pos, int y_pos);
 void keypressSpecial(int key, int x_pos, int y_pos);
 void mouse(int button, int state, int x, int y);
+void requestFrame();
 void rotation_menu(int id);
 
 //--Resource management
 bool initialize();
 void cleanUp();
+void bindAttributes(GLuint newProgram);
+bool bindProgram(GLuint newProgram);
+void reloadShaders();
+bool streamModelFile();
+bool updateLoading(float budgetMs);
+void waitForLoader();
+void placeCopies();
+void drawModels();
 
 //--Random time things
 float getDT();
 std::chrono::time_point<std::chrono::high_resolution_clock> t1,t2;
 
-//Shader Loader
-const char* loadShaderFromFile(const char* fileName);
-
-//OBJ loader
-bool loadOBJ(const char * fileName, std::vector<Vertex> &geometry); 
-
-//String splitter
-void split(const std::string &s, std::vector<unsigned int> &elems);
-
-//Text display
-void glutPrintText(float x, float y, char* text, void * font, 
-                              float r, float g, float b, float a);
 //--Main
 int main(int argc, char **argv)
 {	
-	if( argc > 1 )
-	{
-		objFileName=argv[1];
-	}
-  if( argc > 2 )
-  {
-    scaleFactor=atof(argv[2]);
-  }
-    // Initialize glut
-    glutInit(&argc, argv);
-    glutInitDisplayMode(GLUT_DOUBLE | GLUT_DEPTH);
-    glutInitWindowSize(w, h);
-    // Name and create the Window
-    glutCreateWindow("Object Loading Example");
+    // Options start with --, anything else is the model and then the scale
+    // --headless draws offscreen instead of opening a window and
+    // --frames is how many frames it draws before exiting
+    // --instances draws that many copies of the model in a grid
+    // --fixed-dt moves the scene on by that many seconds every frame
+    // --golden, --baseline and the rest check a headless run (headless.h)
+    // --capture records every frame to a .y4m file or numbered PPM files
+    // --fps sets the frame rate the window is paced to, 0 is unpaced
+    // --on-demand only draws when the scene changed or there was input
+    int positional = 0;
+    int frames = 100;
+    bool offscreen = false;
+    for( int i = 1; i < argc; i++ )
+    {
+        if( strcmp(argv[i], "--stream") == 0 )
+        {
+            streamModel = true;
+        }
+        else if( strcmp(argv[i], "--mem-cap") == 0 && i + 1 < argc )
+        {
+            streamOptions.memoryCap = (size_t)(atof(argv[++i]) * (1 << 20));
+        }
+        else if( strcmp(argv[i], "--max-buffer") == 0 && i + 1 < argc )
+        {
+            streamOptions.maxBufferSize = (size_t)(atof(argv[++i]) * (1 << 20));
+        }
+        else if( strcmp(argv[i], "--headless") == 0 )
+        {
+            offscreen = true;
+        }
+        else if( strcmp(argv[i], "--frames") == 0 && i + 1 < argc )
+        {
+            frames = atoi(argv[++i]);
+        }
+        else if( strcmp(argv[i], "--csv") == 0 && i + 1 < argc )
+        {
+            csvFileName = argv[++i];
+        }
+        else if( strcmp(argv[i], "--compact") == 0 )
+        {
+            compactVertices = true;
+        }
+        else if( strcmp(argv[i], "--overdraw") == 0 )
+        {
+            reduceOverdraw = true;
+        }
+        else if( strcmp(argv[i], "--lod") == 0 )
+        {
+            useLods = true;
+        }
+        else if( strcmp(argv[i], "--instances") == 0 && i + 1 < argc )
+        {
+            instanceCount = std::max(atoi(argv[++i]), 1);
+        }
+        else if( strcmp(argv[i], "--fixed-dt") == 0 && i + 1 < argc )
+        {
+            fixedStep = std::max(atof(argv[++i]), 0.0);
+        }
+        else if( strcmp(argv[i], "--capture") == 0 && i + 1 < argc )
+        {
+            captureTarget = argv[++i];
+        }
+        else if( strcmp(argv[i], "--fps") == 0 && i + 1 < argc )
+        {
+            targetFps = std::max(atof(argv[++i]), 0.0);
+        }
+        else if( strcmp(argv[i], "--on-demand") == 0 )
+        {
+            onDemand = true;
+        }
+        else if( headlessOption(argc, argv, i) )
+        {
+            // a scenario check, headlessOption took it
+        }
+        else if( positional == 0 )
+        {
+            objFileName = argv[i];
+            positional++;
+        }
+        else if( positional == 1 )
+        {
+            scaleFactor = atof(argv[i]);
+            positional++;
+        }
+    }
+
+    //the timing overlay is different every run, it is left out of frames
+    //compared with a golden image
+    if( headlessChecks.goldenFile )
+        SHOW_STATS = false;
+
+    if( offscreen )
+    {
+        // No window, render into an offscreen framebuffer instead
+        if( !headlessInit() )
+            return -1;
+    }
+    else
+    {
+        // Initialize glut
+        glutInit(&argc, argv);
+        glutInitDisplayMode(GLUT_DOUBLE | GLUT_DEPTH);
+        glutInitWindowSize(w, h);
+        // Name and create the Window
+        glutCreateWindow("Object Loading Example");
+    }
 
     // Now that the window is created the GL context is fully set up
     // Because of that we can now initialize GLEW to prepare work with shaders
     GLenum status = glewInit();
-    if( status != GLEW_OK)
+    if( !glewStatusOk(status) )
     {
         std::cerr << "[F] GLEW NOT INITIALIZED: ";
         std::cerr << glewGetErrorString(status) << std::endl;
@@ -115,97 +251,412 @@ int main(int argc, char **argv)
     }
 
     // Set all of the callbacks to GLUT that we need
-    glutDisplayFunc(render);// Called when its time to display
-    glutReshapeFunc(reshape);// Called if the window is resized
-    glutIdleFunc(update);// Called if there is nothing else to do
-    glutKeyboardFunc(keyboard);// Called if there is keyboard input
-    glutSpecialFunc(keypressSpecial);// Called if there is special keyboard input
-    glutMouseFunc(mouse); //Called on mouse click
+    // (a headless run calls update and render itself)
+    if( !headless )
+    {
+        glutDisplayFunc(render);// Called when its time to display
+        glutReshapeFunc(reshape);// Called if the window is resized
+        glutIdleFunc(idle);// Called if there is nothing else to do
+        glutVisibilityFunc(visibility);// Called when the window is hidden or shown
+        glutKeyboardFunc(keyboard);// Called if there is keyboard input
+        glutSpecialFunc(keypressSpecial);// Called if there is special keyboard input
+        glutMouseFunc(mouse); //Called on mouse click
     
-    //Add our right click menu
-    /*
-    glutCreateMenu(rotation_menu);
-    glutAddMenuEntry("Start Rotation", 1);
-    glutAddMenuEntry("Stop Rotation", 2);
-    glutAddMenuEntry("Quit", 3);
-    glutAttachMenu(GLUT_RIGHT_BUTTON);
-    */
+        //Add our right click menu
+        /*
+        glutCreateMenu(rotation_menu);
+        glutAddMenuEntry("Start Rotation", 1);
+        glutAddMenuEntry("Stop Rotation", 2);
+        glutAddMenuEntry("Quit", 3);
+        glutAttachMenu(GLUT_RIGHT_BUTTON);
+        */
+    }
+
     // Initialize all of our resources(shaders, geometry)
+    atexit(waitForLoader);// the key handler exit()s without cleanUp
     bool init = initialize();
+    bool passed = true;
     if(init)
     {
+        frameStatsInit(csvFileName);
+        //a headless run draws its frames as fast as it can
+        pacerInit(headless ? 0 : targetFps);
+        if( !headless )
+        {
+            pacerMatchDisplay();
+            atexit(pacerReport);
+        }
+        //frames are labelled with the rate the scene moves at
+        if( captureTarget )
+        {
+            float captureFps = fixedStep > 0 ? 1.0f / fixedStep : (targetFps > 0 ? targetFps : 60.0f);
+            if( captureStart(captureTarget, w, h, captureFps) )
+                atexit(captureStop);// the key handler exit()s too
+            else
+                printf("WARNING: Not capturing\n");
+        }
         t1 = std::chrono::high_resolution_clock::now();
-        glutMainLoop();
+        if( headless )
+            passed = headlessRun(w, h, frames, update, render);
+        else
+            glutMainLoop();
     }
 
     // Clean up after ourselves
     cleanUp();
-    return 0;
+    headlessCleanUp();
+    return init && passed ? 0 : 1;
 }
 
 //--Implementations
 void render()
 {
     //--Render the scene
+    frameStatsBegin(STAGE_RENDER);
+    frameStatsGpuBegin();
+
+    //pick up edited shaders
+    reloadShaders();
 
     //clear the screen
     glClearColor(0.0, 0.0, 0.2, 1.0);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    //Timing overlay
+    if( SHOW_STATS )
+    {
+      char stats[100];
+      const FrameTiming &timing = frameStatsAverage();
+      sprintf(stats, "Frame: %.2f ms (%.0f fps)", timing.frame,
+              timing.frame > 0 ? 1000.0f / timing.frame : 0.0f);
+      textPrint(-0.95f, 0.82f, stats, TEXT_SMALL, 1.0f, 1.0f, 0.0f);
+      sprintf(stats, "CPU update %.3f  render %.3f  swap %.3f ms",
+              timing.stage[STAGE_UPDATE], timing.stage[STAGE_RENDER], timing.stage[STAGE_SWAP]);
+      textPrint(-0.95f, 0.76f, stats, TEXT_SMALL, 1.0f, 1.0f, 0.0f);
+      if( timing.gpu < 0 )
+        sprintf(stats, "GPU n/a");
+      else
+        sprintf(stats, "GPU %.3f ms", timing.gpu);
+      textPrint(-0.95f, 0.70f, stats, TEXT_SMALL, 1.0f, 1.0f, 0.0f);
+      sprintf(stats, "Visible %u  culled %u", timing.visible, timing.culled);
+      textPrint(-0.95f, 0.64f, stats, TEXT_SMALL, 1.0f, 1.0f, 0.0f);
+      sprintf(stats, "Triangles %lu", trianglesDrawn);
+      textPrint(-0.95f, 0.58f, stats, TEXT_SMALL, 1.0f, 1.0f, 0.0f);
+      if( !headless )
+      {
+        const PacerStats &paced = pacerStats();
+        if( targetFps > 0 )
+          sprintf(stats, "Paced to %.0f: %.1f fps  CPU %.0f%%  asleep %.0f%%",
+                  targetFps, paced.fps, paced.cpu, paced.asleep);
+        else
+          sprintf(stats, "Unpaced: %.1f fps  CPU %.0f%%", paced.fps, paced.cpu);
+        textPrint(-0.95f, 0.52f, stats, TEXT_SMALL, 1.0f, 1.0f, 0.0f);
+      }
+    }
     
-    for (unsigned int i=0;i<models.size(); i++) 
-    {
-      
-      mvp = projection * view * models[i];
-
-      //enable the shader program
-      glUseProgram(program);
-
-      //upload the matrix to the shader
-      glUniformMatrix4fv(loc_mvpmat, 1, GL_FALSE, glm::value_ptr(mvp));
-
-      //set up the Vertex Buffer Object so it can be drawn
-      glEnableVertexAttribArray(loc_position);
-      glEnableVertexAttribArray(loc_color);
-      glBindBuffer(GL_ARRAY_BUFFER, vbo_geometry);
-      //set pointers into the vbo for each of the attributes(position and color)
-      glVertexAttribPointer( loc_position,//location of attribute
-                             3,//number of elements
-                             GL_FLOAT,//type
-                             GL_FALSE,//normalized?
-                             sizeof(Vertex),//stride
-                             0);//offset
-
-      glVertexAttribPointer( loc_color,
-                             3,
-                             GL_FLOAT,
-                             GL_FALSE,
-                             sizeof(Vertex),
-                             (void*)offsetof(Vertex,color));
-
-      glDrawArrays(GL_TRIANGLES, 0, numVertices);//mode, starting index, count
+    //the model draws once it has finished loading, until then the
+    //frame is just the overlay and a slice of the upload
+    if( !updateLoading(UPLOAD_BUDGET_MS) )
+        exit(-1);
+    if( modelReady )
+    {
+      drawModels();
     }
-    //clean up
-    glDisableVertexAttribArray(loc_position);
-    glDisableVertexAttribArray(loc_color);
+    else
+    {
+      char status[100];
+      if( loaderPrepared(loader) )
+        sprintf(status, "Uploading %.0f%%", loaderProgress(loader) * 100.0f);
+      else
+        sprintf(status, "Loading %.80s", objFileName);
+      textPrint(-0.95f, 0.9f, status, TEXT_LARGE, 1.0f, 1.0f, 1.0f);
+    }
+
+    //all the text queued above goes on top in one draw
+    textDraw(w, h);
+
+    //queues the copy for --capture, the pixels are written out later
+    captureFrame(w, h);
                            
+    frameStatsGpuEnd();
+    frameStatsEnd(STAGE_RENDER);
+
     //swap the buffers
-    glutSwapBuffers(); 
+    frameStatsBegin(STAGE_SWAP);
+    if( headless )
+        headlessSwapBuffers();
+    else
+        glutSwapBuffers();
+    frameStatsEnd(STAGE_SWAP);
+    frameStatsEndFrame(); 
     
 }
 
+//Culls, picks levels of detail and draws every copy of the model
+void drawModels()
+{
+    vp = projection * view;
+
+    //throw away every copy outside the view before any GL work is done
+    Frustum frustum;
+    frustumFromMatrix(vp, frustum);
+    visibleIndices.resize(models.size());
+    size_t visibleCount = cullSpheres(frustum, models.data(), models.size(),
+                                      modelCenter, modelRadius, visibleIndices.data());
+    frameStatsCounts(visibleCount, models.size() - visibleCount);
+
+    //pick a level for every visible copy from how many pixels a model unit
+    //covers at its distance, then sort the copies by level
+    unsigned int levels = std::max(lods.size(), (size_t)1);
+    lodStarts.assign(levels + 1, 0);
+    for (size_t i=0;i<visibleCount; i++)
+    {
+      unsigned int index = visibleIndices[i];
+      if( levels > 1 )
+      {
+        float pixels = pixelsPerUnit(view, projection, models[index], modelCenter, h);
+        instanceLods[index] = selectLod(&lods[0], levels, pixels, instanceLods[index]);
+      }
+      lodStarts[instanceLods[index] + 1]++;
+    }
+    for (unsigned int l=0;l<levels; l++)
+      lodStarts[l + 1] += lodStarts[l];
+
+    //compact positions are fractions of the model's box, full ones go
+    //through untouched
+    glm::vec3 positionScale(1.0f, 1.0f, 1.0f), positionOffset(0.0f, 0.0f, 0.0f);
+    if( compactVertices )
+    {
+      positionScale = modelMax - modelMin;
+      positionOffset = modelMin;
+    }
+
+    //with instancing this frame's uniforms and matrices are written straight
+    //into the ring, the sorted matrices land where the draws read them. A
+    //frame whose region cannot be mapped draws the copies one at a time.
+    glm::mat4 *sortedModels;
+    size_t frameOffset = 0, instanceOffset = 0;
+    bool ringed = instancing &&
+                  ringBeginFrame(frameRing, sizeof(FrameData) + uniformAlignment + sizeof(glm::mat4) * (visibleCount + 1));
+    if( ringed )
+    {
+      FrameData *frameData;
+      frameOffset = ringAlloc(frameRing, sizeof(FrameData), uniformAlignment, (void**)&frameData);
+      frameData->vpMatrix = vp;
+      frameData->positionScale = glm::vec4(positionScale, 0.0f);
+      frameData->positionOffset = glm::vec4(positionOffset, 0.0f);
+      instanceOffset = ringAlloc(frameRing, sizeof(glm::mat4) * visibleCount, sizeof(glm::mat4), (void**)&sortedModels);
+    }
+    else
+    {
+      visibleModels.resize(visibleCount);
+      sortedModels = visibleModels.data();
+      //a driver with uniform buffers but no instancing still compiles the
+      //block, it gets a small buffer of its own, refilled every frame
+      if( frameBlock )
+      {
+        FrameData frameData;
+        frameData.vpMatrix = vp;
+        frameData.positionScale = glm::vec4(positionScale, 0.0f);
+        frameData.positionOffset = glm::vec4(positionOffset, 0.0f);
+        if( frameDataBuffer == 0 )
+          glGenBuffers(1, &frameDataBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, frameDataBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), &frameData, GL_STREAM_DRAW);
+        glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, frameDataBuffer, 0, sizeof(FrameData));
+      }
+    }
+    std::vector<unsigned int> next(lodStarts.begin(), lodStarts.end() - 1);
+    for (size_t i=0;i<visibleCount; i++)
+      sortedModels[next[instanceLods[visibleIndices[i]]]++] = models[visibleIndices[i]];
+    //everything for this frame is written, the ring can be read from now
+    if( ringed )
+    {
+      ringFinishWrites(frameRing);
+      if( frameBlock )
+        glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, frameRing.buffer, frameOffset, sizeof(FrameData));
+    }
+
+    //enable the shader program
+    glUseProgram(program);
+
+    //without the block the uniforms are set one by one
+    if( !frameBlock )
+    {
+      glUniformMatrix4fv(loc_vpmat, 1, GL_FALSE, glm::value_ptr(vp));
+      glUniform3fv(loc_positionScale, 1, glm::value_ptr(positionScale));
+      glUniform3fv(loc_positionOffset, 1, glm::value_ptr(positionOffset));
+    }
+
+    //set up the Vertex Buffer Object so it can be drawn
+    glEnableVertexAttribArray(loc_position);
+    glEnableVertexAttribArray(loc_color);
+
+    if( ringed && visibleCount > 0 )
+    {
+      for (int c=0;c<4; c++)
+        glEnableVertexAttribArray(loc_model + c);
+    }
+
+    //the copies are grouped by level of detail, one pass over the batches
+    //per level (or without instancing, per copy with the model matrix as a
+    //constant attribute)
+    trianglesDrawn = 0;
+    for (unsigned int l=0;l<levels; l++)
+    {
+      unsigned int first = lodStarts[l];
+      unsigned int count = lodStarts[l + 1] - first;
+      if( count == 0 )
+        continue;
+
+      if( ringed )
+      {
+        //this level's matrices start part way into this frame's region
+        glBindBuffer(GL_ARRAY_BUFFER, frameRing.buffer);
+        for (int c=0;c<4; c++)
+        {
+          glVertexAttribPointer( loc_model + c,
+                                 4,
+                                 GL_FLOAT,
+                                 GL_FALSE,
+                                 sizeof(glm::mat4),
+                                 (void*)(instanceOffset + sizeof(glm::mat4) * first + sizeof(glm::vec4) * c));//one column each
+        }
+      }
+
+      unsigned int passes = ringed ? 1 : count;
+      for (unsigned int i=0;i<passes; i++) 
+      {
+        if( !ringed )
+        {
+          for (int c=0;c<4; c++)
+            glVertexAttrib4fv(loc_model + c, glm::value_ptr(visibleModels[first + i][c]));
+        }
+
+        for (unsigned int b=0;b<batches.size(); b++)
+        {
+          glBindBuffer(GL_ARRAY_BUFFER, batches[b].vbo);
+          glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batches[b].ibo);
+          //set pointers into the vbo for each of the attributes(position and color)
+          if( compactVertices )
+          {
+            glVertexAttribPointer( loc_position,//location of attribute
+                                   3,//number of elements
+                                   GL_UNSIGNED_SHORT,//type
+                                   GL_TRUE,//normalized? (0 to 65535 becomes 0 to 1)
+                                   sizeof(PackedVertex),//stride
+                                   0);//offset
+
+            glVertexAttribPointer( loc_color,
+                                   4,
+                                   GL_UNSIGNED_BYTE,
+                                   GL_TRUE,
+                                   sizeof(PackedVertex),
+                                   (void*)offsetof(PackedVertex,color));
+          }
+          else
+          {
+            glVertexAttribPointer( loc_position,//location of attribute
+                                   3,//number of elements
+                                   GL_FLOAT,//type
+                                   GL_FALSE,//normalized?
+                                   sizeof(Vertex),//stride
+                                   0);//offset
+
+            glVertexAttribPointer( loc_color,
+                                   3,
+                                   GL_FLOAT,
+                                   GL_FALSE,
+                                   sizeof(Vertex),
+                                   (void*)offsetof(Vertex,color));
+          }
+
+          //a level is a range of the index buffer, without levels it is all of it
+          GLsizei indexCount = batches[b].count;
+          size_t indexOffset = 0;
+          if( !lods.empty() )
+          {
+            indexCount = lods[l].indexCount;
+            indexOffset = lods[l].firstIndex * (batches[b].indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint));
+          }
+          if( ringed )
+            glDrawElementsInstanced(GL_TRIANGLES, indexCount, batches[b].indexType, (void*)indexOffset, count);//mode, count, type, offset, instances
+          else
+            glDrawElements(GL_TRIANGLES, indexCount, batches[b].indexType, (void*)indexOffset);//mode, count, type, offset
+          trianglesDrawn += (unsigned long)indexCount / 3 * (ringed ? count : 1);
+        }
+      }
+    }
+    if( ringed && visibleCount > 0 )
+    {
+      for (int c=0;c<4; c++)
+        glDisableVertexAttribArray(loc_model + c);
+    }
+    //the GPU is done with this region once everything above has run
+    if( ringed )
+      ringEndFrame(frameRing);
+    //clean up
+    glDisableVertexAttribArray(loc_position);
+    glDisableVertexAttribArray(loc_color);
+}
+
 void update()
 {
     static float rotAngle = 0.0;
     
+    frameStatsBegin(STAGE_UPDATE);
     float dt = getDT();// if you have anything moving, use dt.
 
-    rotAngle += dt*90;
+    //paused, the clock still runs so resuming does not jump (and requestFrame
+    //restarts it when the idle calls had stopped)
+    if( !PAUSED )
+      rotAngle += dt*90;
     //THIS IS THE OBJECT'S UPDATE
-    models[0] = glm::rotate(glm::mat4(1.0f), rotAngle, glm::vec3(0, 1, 0));
-    models[0] = glm::scale(models[0], glm::vec3(scaleFactor,scaleFactor,scaleFactor));
+    if( !models.empty() )
+      placeModels(modelOffsets.data(), models.size(), rotAngle, scaleFactor, models.data());
+    frameStatsEnd(STAGE_UPDATE);
     // Update the state of the scene
-    glutPostRedisplay();//call the display callback
+    if( !headless )
+        glutPostRedisplay();//call the display callback
+}
+
+//The idle callback, paces the frames instead of spinning
+void idle()
+{
+    //the model stops changing once it is loaded and paused
+    bool changing = !onDemand || !PAUSED || !modelReady;
+    bool asked = pacerTakeRequest();
+    if( !windowVisible || !(changing || asked) )
+    {
+        //nothing new to draw: stop the idle calls, GLUT then blocks waiting
+        //for events until input or the window coming back asks for a frame
+        glutIdleFunc(NULL);
+        idleStopped = true;
+        return;
+    }
+    pacerWait();
+    update();
+}
+
+void visibility(int state)
+{
+    windowVisible = state == GLUT_VISIBLE;
+    if( windowVisible )
+        requestFrame();
+}
+
+//Input changed something, draw it even when drawing on demand
+void requestFrame()
+{
+    pacerRequestFrame();
+    glutIdleFunc(idle);
+    //getDT was not called while the idle calls were off, the time the window
+    //sat paused or hidden must not reach the next update
+    if( idleStopped )
+    {
+        t1 = std::chrono::high_resolution_clock::now();
+        idleStopped = false;
+    }
 }
 
 
@@ -218,7 +669,7 @@ void reshape(int n_w, int n_h)
     //Update the projection matrix as well
     //See the init function for an explaination
     projection = glm::perspective(45.0f, float(w)/float(h), 0.01f, 100.0f);
-
+    requestFrame();
 }
 
 void keyboard(unsigned char key, int x_pos, int y_pos)
@@ -239,10 +690,19 @@ void keyboard(unsigned char key, int x_pos, int y_pos)
       if( SPEED_MOD < 5 )
         SPEED_MOD += 0.5;
     }
+    if( key == 72 || key == 104 )//h or H
+    {
+        SHOW_STATS = !SHOW_STATS;
+    }
+    if( key == 80 || key == 112 )//p or P
+    {
+        PAUSED = !PAUSED;
+    }
     if(key == 27)//ESC
     {
         exit(0);
     }
+    requestFrame();
 }
 void keypressSpecial (int key, int x, int y)
 {	
@@ -256,7 +716,7 @@ void keypressSpecial (int key, int x, int y)
   {
     PLANET_MOD=1;
   }
-	
+  requestFrame();
 }
 void mouse(int button, int state, int x, int y)
 {
@@ -264,95 +724,109 @@ void mouse(int button, int state, int x, int y)
   {
     SPIN_MOD *= -1;
   }
+  requestFrame();
 }
 
 bool initialize()
 {
     // Initialize basic geometry and shaders for this example
-    std::vector<Vertex> geometryVec;
-    loadOBJ(objFileName,geometryVec);
-    
-    numVertices = geometryVec.size();
-    // Create a Vertex Buffer object to store this vertex info on the GPU
-    glGenBuffers(1, &vbo_geometry);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_geometry);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex)*numVertices, &geometryVec[0], GL_STATIC_DRAW);
-
-    //--Geometry done
-
-    GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+    // the model is read on the loader thread while the shaders compile
+    // here (streamed models upload as they parse, so they load right away)
+    if( streamModel )
+    {
+        if( !streamModelFile() )
+        {
+            std::cerr << "[F] FAILED TO LOAD " << objFileName << std::endl;
+            return false;
+        }
+    }
+    else
+    {
+        LoadOptions options = { useLods, reduceOverdraw, compactVertices };
+        loaderStart(loader, objFileName, options);
+    }
 
     //Shader Sources
     // Now uses the shader loader
     // Given our current file structure, these paths should always work
     const char *vs = loadShaderFromFile("assets/shaders/vs.txt");
     const char *fs = loadShaderFromFile("assets/shaders/fs.txt");
-    
-    //compile the shaders
-    GLint shader_status;
 
-    // Vertex shader first
-    glShaderSource(vertex_shader, 1, &vs, NULL);
-    glCompileShader(vertex_shader);
-    //check the compile status
-    glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &shader_status);
-    if(!shader_status)
+    //A binary left by an earlier run skips compiling and linking, as long
+    //as the sources and the driver are the same and the driver takes it
+    program = loadProgramBinary(PROGRAM_CACHE_FILE, vs, fs);
+    if( program == 0 )
     {
-        std::cerr << "[F] FAILED TO COMPILE VERTEX SHADER!" << std::endl;
-        return false;
-    }
+        GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+        GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+
+        //compile the shaders
+        GLint shader_status;
+
+        // Vertex shader first
+        glShaderSource(vertex_shader, 1, &vs, NULL);
+        glCompileShader(vertex_shader);
+        //check the compile status
+        glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &shader_status);
+        if(!shader_status)
+        {
+            std::cerr << "[F] FAILED TO COMPILE VERTEX SHADER!" << std::endl;
+            return false;
+        }
 
-    // Now the Fragment shader
-    glShaderSource(fragment_shader, 1, &fs, NULL);
-    glCompileShader(fragment_shader);
-    //check the compile status
-    glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &shader_status);
-    if(!shader_status)
-    {
-        std::cerr << "[F] FAILED TO COMPILE FRAGMENT SHADER!" << std::endl;
-        return false;
-    }
+        // Now the Fragment shader
+        glShaderSource(fragment_shader, 1, &fs, NULL);
+        glCompileShader(fragment_shader);
+        //check the compile status
+        glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &shader_status);
+        if(!shader_status)
+        {
+            std::cerr << "[F] FAILED TO COMPILE FRAGMENT SHADER!" << std::endl;
+            return false;
+        }
 
-    //Now we link the 2 shader objects into a program
-    //This program is what is run on the GPU
-    program = glCreateProgram();
-    glAttachShader(program, vertex_shader);
-    glAttachShader(program, fragment_shader);
-    glLinkProgram(program);
-    //check if everything linked ok
-    glGetProgramiv(program, GL_LINK_STATUS, &shader_status);
-    if(!shader_status)
-    {
-        std::cerr << "[F] THE SHADER PROGRAM FAILED TO LINK" << std::endl;
-        return false;
+        //Now we link the 2 shader objects into a program
+        //This program is what is run on the GPU
+        program = glCreateProgram();
+        glAttachShader(program, vertex_shader);
+        glAttachShader(program, fragment_shader);
+        bindAttributes(program);
+        requestProgramBinary(program);
+        glLinkProgram(program);
+        //check if everything linked ok
+        glGetProgramiv(program, GL_LINK_STATUS, &shader_status);
+        if(!shader_status)
+        {
+            std::cerr << "[F] THE SHADER PROGRAM FAILED TO LINK" << std::endl;
+            return false;
+        }
+
+        //the shader objects are part of the program now
+        glDeleteShader(vertex_shader);
+        glDeleteShader(fragment_shader);
+        saveProgramBinary(PROGRAM_CACHE_FILE, program, vs, fs);
     }
 
+    //Instanced drawing needs per instance attributes (GL 3.3)
+    //without them every copy is still its own set of draw calls
+    //the matrices go through the ring, room for every copy to begin with
+    instancing = GLEW_VERSION_3_3 &&
+                 ringInit(frameRing, sizeof(FrameData) + sizeof(glm::mat4) * instanceCount);
+    if( instancing )
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+
     //Now we set the locations of the attributes and uniforms
     //this allows us to access them easily while rendering
-    loc_position = glGetAttribLocation(program,
-                    const_cast<const char*>("v_position"));
-    if(loc_position == -1)
-    {
-        std::cerr << "[F] POSITION NOT FOUND" << std::endl;
+    if( !bindProgram(program) )
         return false;
-    }
 
-    loc_color = glGetAttribLocation(program,
-                    const_cast<const char*>("v_color"));
-    if(loc_color == -1)
-    {
-        std::cerr << "[F] V_COLOR NOT FOUND" << std::endl;
-        return false;
-    }
+    //edits to the shaders are picked up while running
+    if( !shaderWatchInit("assets/shaders", "vs.txt", "fs.txt", PROGRAM_CACHE_FILE, bindAttributes) )
+        printf("WARNING: Could not watch assets/shaders, shader reload is off\n");
 
-    loc_mvpmat = glGetUniformLocation(program,
-                    const_cast<const char*>("mvpMatrix"));
-    if(loc_mvpmat == -1)
-    {
-        std::cerr << "[F] MVPMATRIX NOT FOUND" << std::endl;
-        return false;
-    }
+    //the font is baked once, the overlay text is drawn with it every frame
+    if( !textInit() )
+        printf("WARNING: No text overlay\n");
     
     //--Init the view and projection matrices
     //  if you will be having a moving camera the view matrix will need to more dynamic
@@ -371,198 +845,237 @@ bool initialize()
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LESS);
 
-    //load our models
-    models.push_back(model);
+    if( streamModel )
+    {
+        placeCopies();
+    }
+    else if( headless )
+    {
+        //no window to keep responsive, so every measured frame gets the model
+        loaderWait(loader);
+        if( !updateLoading(1e30f) )
+            return false;
+    }
     //and its done
     return true;
 }
 
-void cleanUp()
+//load our models, extra copies are laid out on a grid going away
+//from the camera, spaced by the size of the model
+void placeCopies()
 {
-    // Clean up, Clean up
-    glDeleteProgram(program);
-    glDeleteBuffers(1, &vbo_geometry);
+    glm::vec3 size = (modelMax - modelMin) * scaleFactor;
+    float spacing = std::max(std::max(size.x, size.z), 1e-3f) * 1.5f;
+    int side = (int)ceil(sqrt((float)instanceCount));
+    for (int i=0;i<instanceCount; i++)
+    {
+      modelOffsets.push_back(glm::vec3(((i % side) - (side - 1) / 2.0f) * spacing, 0.0f, (i / side) * spacing));
+      models.push_back(model);
+    }
+    instanceLods.assign(instanceCount, 0);
+    modelReady = true;
 }
 
-//returns the time delta
-float getDT()
+//Uploads a slice of the model once the loader thread has it ready and
+//places the copies once the last slice is in. False if it failed to load.
+bool updateLoading(float budgetMs)
 {
-    float ret;
-    t2 = std::chrono::high_resolution_clock::now();
-    ret = std::chrono::duration_cast< std::chrono::duration<float> >(t2-t1).count();
-    t1 = std::chrono::high_resolution_clock::now();
-    return ret;
+    if( modelReady || !loaderPrepared(loader) )
+        return true;
+    const PreparedModel &prepared = loader.model;
+    if( !prepared.ok )
+    {
+        std::cerr << "[F] FAILED TO LOAD " << objFileName << std::endl;
+        return false;
+    }
+    if( !loaderUpload(loader, budgetMs) )
+        return true;
+
+    lods = prepared.lods;
+    modelMin = prepared.boundsMin;
+    modelMax = prepared.boundsMax;
+    modelCenter = prepared.sphereCenter;
+    modelRadius = prepared.sphereRadius;
+    batches.push_back(loader.batch);
+    loaderCleanUp(loader);
+    placeCopies();
+    return true;
 }
 
-//Loads a shader from a text file
-const char* loadShaderFromFile(const char* fileName)
+void waitForLoader()
 {
-  std::string fileContents;
-  
-  std::ifstream in(fileName, std::ios::in | std::ios::binary);
-  if (in)
-  {
-    in.seekg(0, std::ios::end);
-    fileContents.resize(in.tellg());
-    in.seekg(0, std::ios::beg);
-    in.read(&fileContents[0], fileContents.size());
-    in.close();
-  }
-  else
-  {
-    std::cout << std::endl << "Could not open shader file: " << fileName << std::endl << std::endl;
-    throw;
-  }
-  
-  char * shader = new char[fileContents.size()];
-  strcpy(shader, fileContents.c_str());
-  return shader;
+    loaderWait(loader);
 }
 
-void rotation_menu(int id)
+//Streams the model given on the command line into batches
+bool streamModelFile()
 {
-  switch(id)
-  {
-    //Start rotation
-    case 1:
-      ROTATION_FLAG = 1;
-      break;
-    //Stop rotation
-    case 2:
-      ROTATION_FLAG = 0;
-      break;
-    //Quit
-    case 3:
-      exit(0);
-      break;
-  }
-  glutPostRedisplay();
+    // Models too big for memory are streamed straight to the GPU
+    if( useLods )
+        printf("WARNING: --lod is ignored for streamed models\n");
+    if( compactVertices )
+        printf("WARNING: --compact is ignored for streamed models\n");
+    compactVertices = false;
+    if( !streamOBJ(objFileName, streamOptions, batches, modelMin, modelMax) )
+        return false;
+    //the vertices are gone by now, so the sphere just covers the box
+    modelCenter = (modelMin + modelMax) * 0.5f;
+    modelRadius = glm::length(modelMax - modelMin) * 0.5f;
+    return true;
 }
 
-void glutPrintText(float x, float y, char* text, void * font, 
-                              float r, float g, float b, float a)
+void bindAttributes(GLuint newProgram)
 {
-    // disable shaders
-    glUseProgram(0);
-
-    // set color of text
-    glColor3f(r,g,b);
-
-    // set position of text
-    glRasterPos2f(x,y);
-    
-    // iterate through string to print text
-    while (*text) {
-        glutBitmapCharacter(font, *text);
-        text++;
-    }
- 
-    // re-enable shaders
-    glUseProgram(program);
+    //keep the per vertex position on attribute 0, the model matrix can
+    //then be a constant attribute when there is no instancing
+    glBindAttribLocation(newProgram, 0, "v_position");
 }
 
-bool loadOBJ(const char * fileName, std::vector<Vertex> &geometry) 
+bool bindProgram(GLuint newProgram)
 {
-    geometry.clear();
-    std::vector<unsigned int> vertexIndices;
-    std::vector<glm::vec3> temp_vertices; 
-
-    FILE * file = fopen(fileName, "r");
-    if ( file == NULL ) {
-        printf("ERROR: Object file not found!!");
-        exit(-1);
+    //look everything up before touching the globals, a reloaded program
+    //that is missing something must leave the old one fully in place
+    GLint position = glGetAttribLocation(newProgram,
+                    const_cast<const char*>("v_position"));
+    if(position == -1)
+    {
+        std::cerr << "[F] POSITION NOT FOUND" << std::endl;
+        return false;
     }
 
-    while (true) {
-
-        char lineHeader[128]; 
+    GLint color = glGetAttribLocation(newProgram,
+                    const_cast<const char*>("v_color"));
+    if(color == -1)
+    {
+        std::cerr << "[F] V_COLOR NOT FOUND" << std::endl;
+        return false;
+    }
 
-        //quit when end of line
-        if (fscanf(file, "%s", lineHeader) == EOF)
-            break;
+    GLint modelMatrix = glGetAttribLocation(newProgram,
+                    const_cast<const char*>("v_model"));
+    if(modelMatrix == -1)
+    {
+        std::cerr << "[F] V_MODEL NOT FOUND" << std::endl;
+        return false;
+    }
 
-    //get vertices
-        if ( strcmp( lineHeader, "v" ) == 0 ) 
+    //the per frame uniforms come as one block when the driver has uniform
+    //buffers (vs.txt declares it whenever it can), or are set one by one
+    //when it does not
+    GLuint block = GL_INVALID_INDEX;
+    if( GLEW_VERSION_3_1 || GLEW_ARB_uniform_buffer_object )
+        block = glGetUniformBlockIndex(newProgram, "FrameData");
+    GLint vpmat = -1, positionScale = -1, positionOffset = -1;
+    if( block != GL_INVALID_INDEX )
+    {
+        glUniformBlockBinding(newProgram, block, FRAME_DATA_BINDING);
+    }
+    else
+    {
+        vpmat = glGetUniformLocation(newProgram,
+                        const_cast<const char*>("vpMatrix"));
+        if(vpmat == -1)
         {
-            glm::vec3 vertex;
-            fscanf(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z );
-            temp_vertices.push_back(vertex);
+            std::cerr << "[F] VPMATRIX NOT FOUND" << std::endl;
+            return false;
         }
-      
-        //get faces
-        else if ( strcmp( lineHeader, "f" ) == 0 ) 
+
+        positionScale = glGetUniformLocation(newProgram,
+                        const_cast<const char*>("positionScale"));
+        positionOffset = glGetUniformLocation(newProgram,
+                        const_cast<const char*>("positionOffset"));
+        if(positionScale == -1 || positionOffset == -1)
         {
-            std::vector<unsigned int> lineIndices;
-            char buff[1024];
-            
-            //Get the list of vertices
-            fgets(buff,1024,file);
-            
-            //Split the list into a vector
-            split(buff,lineIndices);
-            
-            //Triangulate the face
-            for( unsigned int i=1; i < lineIndices.size()-1; i++ )
-            {
-              vertexIndices.push_back(lineIndices[0]);
-              vertexIndices.push_back(lineIndices[i]);
-              vertexIndices.push_back(lineIndices[i+1]);
-            }
+            std::cerr << "[F] POSITIONSCALE/POSITIONOFFSET NOT FOUND" << std::endl;
+            return false;
         }
+    }
 
+    if( instancing )
+    {
+        //the divisors belong to the locations, not the program
+        if( newProgram != program )
+            for (int c=0;c<4; c++)
+                glVertexAttribDivisor(loc_model + c, 0);
+        for (int c=0;c<4; c++)
+            glVertexAttribDivisor(modelMatrix + c, 1);// advance once per instance
+    }
 
+    program = newProgram;
+    loc_position = position;
+    loc_color = color;
+    loc_model = modelMatrix;
+    frameBlock = block != GL_INVALID_INDEX;
+    loc_vpmat = vpmat;
+    loc_positionScale = positionScale;
+    loc_positionOffset = positionOffset;
+    return true;
+}
 
-        else {
-            //junk? or something we haven't learned yet
-            char buff[1000];
-            fgets(buff, 1000, file);
-        }
-
+void reloadShaders()
+{
+    //swaps in a rebuilt program once the driver has finished it, the
+    //frames before that keep drawing with the old one
+    GLuint reloaded = shaderWatchPoll();
+    if( reloaded == 0 )
+        return;
+    GLuint old = program;
+    if( bindProgram(reloaded) )
+    {
+        glDeleteProgram(old);
+        printf("Shaders reloaded\n");
     }
-    srand(time(NULL));
-    //for all the vertices
-    for ( unsigned int i=0; i<vertexIndices.size(); i++ ) 
+    else
     {
-
-        //get index
-        unsigned int vertexIndex = vertexIndices[i];
-
-        Vertex newVertex; 
-        
-        glm::vec3 tmpVec = temp_vertices[ vertexIndex-1 ];
-        newVertex.position[0] = (fabs(tmpVec.x) < 1e-20)? 0 : tmpVec.x;
-        newVertex.position[1] = (fabs(tmpVec.y) < 1e-20)? 0 : tmpVec.y;
-        newVertex.position[2] = (fabs(tmpVec.z) < 1e-20)? 0 : tmpVec.z;
-        newVertex.color[0] = (float)rand()/(float)RAND_MAX;
-        newVertex.color[1] = (float)rand()/(float)RAND_MAX;
-        newVertex.color[2] = (float)rand()/(float)RAND_MAX;
-        
-        geometry.push_back(newVertex);
+        glDeleteProgram(reloaded);
+        printf("WARNING: Reloaded program is missing attributes, keeping the old program\n");
     }
+}
 
-    //std::cout << "done!"<<std::endl;
-    return true;
+void cleanUp()
+{
+    // Clean up, Clean up
+    shaderWatchStop();
+    captureStop();
+    frameStatsCleanUp();
+    textCleanUp();
+    glDeleteProgram(program);
+    loaderCleanUp(loader);
+    deleteBatches(batches);
+    if( instancing )
+        ringCleanUp(frameRing);
+    if( frameDataBuffer )
+        glDeleteBuffers(1, &frameDataBuffer);
+}
 
+//returns the time delta
+float getDT()
+{
+    if( fixedStep > 0 )
+        return fixedStep;
+    float ret;
+    t2 = std::chrono::high_resolution_clock::now();
+    ret = std::chrono::duration_cast< std::chrono::duration<float> >(t2-t1).count();
+    t1 = std::chrono::high_resolution_clock::now();
+    return ret;
 }
-void split(const std::string &s, std::vector<unsigned int> &elems) 
+
+void rotation_menu(int id)
 {
-    elems.clear();
-    std::istringstream is( s );
-    unsigned int n;
-	if( s.find('/',0) != std::string::npos )
-	{
-		std::string dummy;
-		while( is >> n ) 
-		{
-			elems.push_back(n);
-			is >> dummy;
-		}
-	}
-	else
-	{
-		while( is >> n ) 
-		{
-		     elems.push_back(n);
-		}
-	}
+  switch(id)
+  {
+    //Start rotation
+    case 1:
+      ROTATION_FLAG = 1;
+      break;
+    //Stop rotation
+    case 2:
+      ROTATION_FLAG = 0;
+      break;
+    //Quit
+    case 3:
+      exit(0);
+      break;
+  }
+  requestFrame();
 }
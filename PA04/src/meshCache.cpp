@@ -0,0 +1,210 @@
+#include "meshCache.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <string>
+#include <algorithm>
+
+//--Source fingerprint
+// Size and mtime catch almost every edit, the hash is there for tools
+// that restore timestamps. Hashing every byte of a huge model would cost
+// as much as reading it, so only the ends and a spread of pages are used.
+static uint64_t hashBytes(uint64_t hash, const char *data, size_t size)
+{
+    //FNV-1a
+    for( size_t i = 0; i < size; i++ )
+    {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static bool sourceFingerprint(const char *objFileName, uint64_t &size,
+                              int64_t &mtime, uint64_t &hash)
+{
+    struct stat info;
+    if( stat(objFileName, &info) != 0 )
+        return false;
+    size = info.st_size;
+    mtime = info.st_mtime;
+
+    MappedFile file;
+    if( !mapFile(objFileName, file) )
+        return false;
+
+    const size_t edge = 64 * 1024;
+    const size_t page = 4096;
+    const size_t samples = 64;
+
+    hash = hashBytes(14695981039346656037ULL, (const char*)&size, sizeof(size));
+    if( file.size <= 2 * edge + samples * page )
+    {
+        hash = hashBytes(hash, file.data, file.size);
+    }
+    else
+    {
+        hash = hashBytes(hash, file.data, edge);
+        size_t stride = (file.size - 2 * edge) / samples;
+        for( size_t i = 0; i < samples; i++ )
+            hash = hashBytes(hash, file.data + edge + i * stride, page);
+        hash = hashBytes(hash, file.data + file.size - edge, edge);
+    }
+
+    unmapFile(file);
+    return true;
+}
+
+static std::string cacheFileName(const char *objFileName)
+{
+    return std::string(objFileName) + ".meshcache";
+}
+
+static uint64_t alignTo64(uint64_t offset)
+{
+    return (offset + 63) & ~(uint64_t)63;
+}
+
+static size_t indexSize(uint32_t indexType)
+{
+    return indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+}
+
+bool openMeshCache(const char *objFileName, CachedMesh &cached)
+{
+    cached.header = NULL;
+    cached.vertices = NULL;
+    cached.indices = NULL;
+
+    std::string cacheName = cacheFileName(objFileName);
+    if( !mapFile(cacheName.c_str(), cached.file) )
+        return false;
+
+    //check the header before trusting any of the offsets in it
+    const MeshCacheHeader *header = (const MeshCacheHeader*)cached.file.data;
+    bool valid = cached.file.size >= sizeof(MeshCacheHeader) &&
+                 memcmp(header->magic, MESH_CACHE_MAGIC, 4) == 0 &&
+                 header->version == MESH_CACHE_VERSION &&
+                 header->vertexSize == sizeof(Vertex) &&
+                 (header->indexType == GL_UNSIGNED_SHORT ||
+                  header->indexType == GL_UNSIGNED_INT) &&
+                 header->vertexOffset + (uint64_t)header->vertexCount * sizeof(Vertex) <= cached.file.size &&
+                 header->indexOffset + (uint64_t)header->indexCount * indexSize(header->indexType) <= cached.file.size &&
+                 header->lodCount <= MAX_LODS;
+    for( uint32_t i = 0; valid && i < header->lodCount; i++ )
+        valid = (uint64_t)header->lods[i].firstIndex + header->lods[i].indexCount <= header->indexCount;
+
+    //and that it was built from the file we were asked to load
+    uint64_t size, hash;
+    int64_t mtime;
+    valid = valid && sourceFingerprint(objFileName, size, mtime, hash) &&
+            header->sourceSize == size &&
+            header->sourceMtime == mtime &&
+            header->sourceHash == hash;
+
+    if( !valid )
+    {
+        closeMeshCache(cached);
+        return false;
+    }
+
+    cached.header = header;
+    cached.vertices = (const Vertex*)(cached.file.data + header->vertexOffset);
+    cached.indices = cached.file.data + header->indexOffset;
+    return true;
+}
+
+void closeMeshCache(CachedMesh &cached)
+{
+    unmapFile(cached.file);
+    cached.header = NULL;
+    cached.vertices = NULL;
+    cached.indices = NULL;
+}
+
+bool writeMeshCache(const char *objFileName, const Mesh &mesh)
+{
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MESH_CACHE_MAGIC, 4);
+    header.version = MESH_CACHE_VERSION;
+    header.vertexSize = sizeof(Vertex);
+    if( !sourceFingerprint(objFileName, header.sourceSize,
+                           header.sourceMtime, header.sourceHash) )
+        return false;
+
+    header.vertexCount = mesh.vertices.size();
+    header.indexCount = mesh.indices.size();
+    header.indexType = meshIndexType(mesh);
+    for( int i = 0; i < 3; i++ )
+    {
+        header.boundsMin[i] = mesh.boundsMin[i];
+        header.boundsMax[i] = mesh.boundsMax[i];
+        header.sphereCenter[i] = mesh.sphereCenter[i];
+    }
+    header.sphereRadius = mesh.sphereRadius;
+    header.lodCount = std::min(mesh.lods.size(), (size_t)MAX_LODS);
+    for( uint32_t i = 0; i < header.lodCount; i++ )
+    {
+        header.lods[i].firstIndex = mesh.lods[i].firstIndex;
+        header.lods[i].indexCount = mesh.lods[i].indexCount;
+        header.lods[i].error = mesh.lods[i].error;
+    }
+    header.indexOrder = mesh.indexOrder;
+    header.acmrBefore = mesh.acmrBefore;
+    header.acmrAfter = mesh.acmrAfter;
+    header.atvrBefore = mesh.atvrBefore;
+    header.atvrAfter = mesh.atvrAfter;
+    header.vertexOffset = alignTo64(sizeof(MeshCacheHeader));
+    header.indexOffset = alignTo64(header.vertexOffset +
+                                   (uint64_t)header.vertexCount * sizeof(Vertex));
+
+    //write to a temporary name first so a crash never leaves a cache
+    //that looks valid but is cut short
+    std::string cacheName = cacheFileName(objFileName);
+    std::string tempName = cacheName + ".tmp";
+    FILE *file = fopen(tempName.c_str(), "wb");
+    if( file == NULL )
+    {
+        printf("WARNING: Could not write mesh cache %s\n", cacheName.c_str());
+        return false;
+    }
+
+    static const char padding[64] = { 0 };
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    if( header.vertexOffset > sizeof(header) )
+        ok = ok && fwrite(padding, header.vertexOffset - sizeof(header), 1, file) == 1;
+    if( header.vertexCount )
+        ok = ok && fwrite(&mesh.vertices[0], sizeof(Vertex), header.vertexCount, file) == header.vertexCount;
+    uint64_t written = header.vertexOffset + (uint64_t)header.vertexCount * sizeof(Vertex);
+    if( header.indexOffset > written )
+        ok = ok && fwrite(padding, header.indexOffset - written, 1, file) == 1;
+
+    if( header.indexType == GL_UNSIGNED_SHORT )
+    {
+        //pack in pieces so we never hold a second full copy
+        GLushort shortIndices[4096];
+        for( size_t i = 0; ok && i < mesh.indices.size(); i += 4096 )
+        {
+            size_t count = mesh.indices.size() - i;
+            if( count > 4096 )
+                count = 4096;
+            for( size_t j = 0; j < count; j++ )
+                shortIndices[j] = (GLushort)mesh.indices[i + j];
+            ok = fwrite(shortIndices, sizeof(GLushort), count, file) == count;
+        }
+    }
+    else if( header.indexCount )
+    {
+        ok = ok && fwrite(&mesh.indices[0], sizeof(GLuint), header.indexCount, file) == header.indexCount;
+    }
+
+    ok = (fclose(file) == 0) && ok;
+    if( !ok || rename(tempName.c_str(), cacheName.c_str()) != 0 )
+    {
+        remove(tempName.c_str());
+        printf("WARNING: Could not write mesh cache %s\n", cacheName.c_str());
+        return false;
+    }
+    return true;
+}
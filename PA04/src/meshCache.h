@@ -0,0 +1,72 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include "objLoader.h"
+#include <stdint.h>
+
+//--Binary mesh cache
+// The first time a model is loaded the finished vertex and index blocks
+// are written next to it as <model>.meshcache. Later runs map that file
+// and hand the blocks straight to glBufferData instead of parsing.
+//
+// Layout: header, vertex block, index block. Blocks start on 64 byte
+// boundaries and the index block is already in the final index type.
+// Levels of detail are ranges of the index block, listed in the header.
+
+#define MESH_CACHE_MAGIC "PMSH"
+#define MESH_CACHE_VERSION 4
+
+struct MeshCacheHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t vertexSize;// sizeof(Vertex) when written, catches layout changes
+
+    //identifies the source file the cache was built from
+    uint64_t sourceSize;
+    int64_t sourceMtime;
+    uint64_t sourceHash;
+
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t indexType;// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+
+    float boundsMin[3];
+    float boundsMax[3];
+    float sphereCenter[3];
+    float sphereRadius;
+
+    uint32_t lodCount;// 0 when no levels were built, the whole block is one mesh
+    struct
+    {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        float error;
+    } lods[MAX_LODS];
+
+    uint32_t indexOrder;// an IndexOrder
+    float acmrBefore, acmrAfter;// vertex cache stats of the reordering
+    float atvrBefore, atvrAfter;
+
+    uint64_t vertexOffset;// byte offsets from the start of the file
+    uint64_t indexOffset;
+};
+
+//A cache file mapped into memory, the pointers are only valid until
+//closeMeshCache is called
+struct CachedMesh
+{
+    MappedFile file;
+    const MeshCacheHeader *header;
+    const Vertex *vertices;
+    const void *indices;
+};
+
+//Maps the cache for an OBJ file if there is one that still matches it
+bool openMeshCache(const char *objFileName, CachedMesh &cached);
+void closeMeshCache(CachedMesh &cached);
+
+//Writes the cache for an OBJ file, failing to write it is not fatal
+bool writeMeshCache(const char *objFileName, const Mesh &mesh);
+
+#endif
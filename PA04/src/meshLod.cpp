@@ -0,0 +1,385 @@
+#include "meshLod.h"
+#include <math.h>
+#include <queue>
+#include <algorithm>
+
+//Sum of squared distances to a set of planes, weighted by triangle area
+struct Quadric
+{
+    double a00, a01, a02, a11, a12, a22;
+    double b0, b1, b2;
+    double c;
+    double weight;
+};
+
+static void quadricClear(Quadric &q)
+{
+    q.a00 = q.a01 = q.a02 = q.a11 = q.a12 = q.a22 = 0;
+    q.b0 = q.b1 = q.b2 = 0;
+    q.c = 0;
+    q.weight = 0;
+}
+
+//Plane n.p + d = 0 with a unit normal
+static void quadricAddPlane(Quadric &q, const glm::vec3 &n, double d, double weight)
+{
+    q.a00 += weight * n.x * n.x;
+    q.a01 += weight * n.x * n.y;
+    q.a02 += weight * n.x * n.z;
+    q.a11 += weight * n.y * n.y;
+    q.a12 += weight * n.y * n.z;
+    q.a22 += weight * n.z * n.z;
+    q.b0 += weight * n.x * d;
+    q.b1 += weight * n.y * d;
+    q.b2 += weight * n.z * d;
+    q.c += weight * d * d;
+    q.weight += weight;
+}
+
+static void quadricAdd(Quadric &q, const Quadric &other)
+{
+    q.a00 += other.a00; q.a01 += other.a01; q.a02 += other.a02;
+    q.a11 += other.a11; q.a12 += other.a12; q.a22 += other.a22;
+    q.b0 += other.b0; q.b1 += other.b1; q.b2 += other.b2;
+    q.c += other.c;
+    q.weight += other.weight;
+}
+
+//Mean squared distance from p to the planes of q and of other
+static float collapseError(const Quadric &q, const Quadric &other, const glm::vec3 &p)
+{
+    Quadric sum = q;
+    quadricAdd(sum, other);
+    double x = p.x, y = p.y, z = p.z;
+    double error = sum.a00 * x * x + sum.a11 * y * y + sum.a22 * z * z +
+                   2 * (sum.a01 * x * y + sum.a02 * x * z + sum.a12 * y * z) +
+                   2 * (sum.b0 * x + sum.b1 * y + sum.b2 * z) + sum.c;
+    if( sum.weight > 0 )
+        error /= sum.weight;
+    return error > 0 ? (float)error : 0.0f;
+}
+
+//An edge collapse waiting in the queue, cheapest first. It is stale once
+//either vertex has changed since it was queued.
+struct Collapse
+{
+    float error;
+    GLuint from, to;
+    unsigned int fromVersion, toVersion;
+
+    bool operator<(const Collapse &other) const
+    {
+        return error > other.error;
+    }
+};
+
+struct Simplifier
+{
+    std::vector<glm::vec3> positions;
+    std::vector<GLuint> triangles;// 3 per triangle, collapses rewrite them in place
+    std::vector<unsigned char> triangleDead;
+    std::vector< std::vector<GLuint> > vertexTriangles;// triangles around each vertex
+    std::vector<Quadric> quadrics;
+    std::vector<unsigned int> versions;
+    std::vector<unsigned char> vertexDead;
+    std::vector<unsigned char> border;// on an open edge, only slides along it
+    std::priority_queue<Collapse> queue;
+    size_t liveTriangles;
+};
+
+static bool hasVertex(const GLuint *triangle, GLuint vertex)
+{
+    return triangle[0] == vertex || triangle[1] == vertex || triangle[2] == vertex;
+}
+
+//The vertices sharing a live triangle with v, without repeats
+static void neighbours(const Simplifier &s, GLuint v, std::vector<GLuint> &out)
+{
+    out.clear();
+    const std::vector<GLuint> &around = s.vertexTriangles[v];
+    for( size_t i = 0; i < around.size(); i++ )
+    {
+        if( s.triangleDead[around[i]] )
+            continue;
+        const GLuint *triangle = &s.triangles[around[i] * 3];
+        for( int k = 0; k < 3; k++ )
+        {
+            if( triangle[k] != v && std::find(out.begin(), out.end(), triangle[k]) == out.end() )
+                out.push_back(triangle[k]);
+        }
+    }
+}
+
+//Live triangles using the edge a-b, 1 means it is an open edge
+static unsigned int edgeTriangles(const Simplifier &s, GLuint a, GLuint b)
+{
+    unsigned int count = 0;
+    const std::vector<GLuint> &around = s.vertexTriangles[a];
+    for( size_t i = 0; i < around.size(); i++ )
+    {
+        if( !s.triangleDead[around[i]] && hasVertex(&s.triangles[around[i] * 3], b) )
+            count++;
+    }
+    return count;
+}
+
+//Border vertices may only move along their border, or the outline shrinks
+static bool canMove(const Simplifier &s, GLuint from, GLuint to)
+{
+    if( !s.border[from] )
+        return true;
+    return s.border[to] && edgeTriangles(s, from, to) == 1;
+}
+
+static void queueEdge(Simplifier &s, GLuint a, GLuint b)
+{
+    Collapse collapse;
+    float toB = canMove(s, a, b) ? collapseError(s.quadrics[a], s.quadrics[b], s.positions[b]) : INFINITY;
+    float toA = canMove(s, b, a) ? collapseError(s.quadrics[a], s.quadrics[b], s.positions[a]) : INFINITY;
+    if( toB == INFINITY && toA == INFINITY )
+        return;
+    collapse.error = std::min(toA, toB);
+    collapse.from = toB <= toA ? a : b;
+    collapse.to = toB <= toA ? b : a;
+    collapse.fromVersion = s.versions[collapse.from];
+    collapse.toVersion = s.versions[collapse.to];
+    s.queue.push(collapse);
+}
+
+//False if moving from onto to would turn a triangle over or pinch the
+//surface into a non manifold fin
+static bool collapseAllowed(const Simplifier &s, GLuint from, GLuint to,
+                            std::vector<GLuint> &fromRing, std::vector<GLuint> &toRing)
+{
+    //the two rings may only share the vertices across the edge
+    neighbours(s, from, fromRing);
+    neighbours(s, to, toRing);
+    unsigned int shared = 0;
+    for( size_t i = 0; i < fromRing.size(); i++ )
+    {
+        if( std::find(toRing.begin(), toRing.end(), fromRing[i]) != toRing.end() )
+            shared++;
+    }
+    if( shared > edgeTriangles(s, from, to) )
+        return false;
+
+    const std::vector<GLuint> &around = s.vertexTriangles[from];
+    for( size_t i = 0; i < around.size(); i++ )
+    {
+        const GLuint *triangle = &s.triangles[around[i] * 3];
+        if( s.triangleDead[around[i]] || hasVertex(triangle, to) )
+            continue;
+        glm::vec3 before[3], after[3];
+        for( int k = 0; k < 3; k++ )
+        {
+            before[k] = s.positions[triangle[k]];
+            after[k] = s.positions[triangle[k] == from ? to : triangle[k]];
+        }
+        glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+        glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+        if( glm::dot(normalBefore, normalAfter) <= 0.0f )
+            return false;
+    }
+    return true;
+}
+
+static void collapseEdge(Simplifier &s, GLuint from, GLuint to, std::vector<GLuint> &ring)
+{
+    std::vector<GLuint> &around = s.vertexTriangles[from];
+    std::vector<GLuint> &target = s.vertexTriangles[to];
+    for( size_t i = 0; i < around.size(); i++ )
+    {
+        GLuint t = around[i];
+        if( s.triangleDead[t] )
+            continue;
+        GLuint *triangle = &s.triangles[t * 3];
+        if( hasVertex(triangle, to) )
+        {
+            //the triangles on the edge itself disappear
+            s.triangleDead[t] = 1;
+            s.liveTriangles--;
+            continue;
+        }
+        for( int k = 0; k < 3; k++ )
+        {
+            if( triangle[k] == from )
+                triangle[k] = to;
+        }
+        target.push_back(t);
+    }
+    std::vector<GLuint>().swap(around);
+
+    //drop the dead triangles so the lists do not keep growing
+    size_t kept = 0;
+    for( size_t i = 0; i < target.size(); i++ )
+    {
+        if( !s.triangleDead[target[i]] )
+            target[kept++] = target[i];
+    }
+    target.resize(kept);
+
+    quadricAdd(s.quadrics[to], s.quadrics[from]);
+    s.vertexDead[from] = 1;
+    s.versions[to]++;
+
+    //every edge around the merged vertex has a new cost
+    neighbours(s, to, ring);
+    for( size_t i = 0; i < ring.size(); i++ )
+        queueEdge(s, to, ring[i]);
+}
+
+static void appendLevel(Mesh &mesh, const Simplifier &s, float error)
+{
+    MeshLod lod;
+    lod.firstIndex = mesh.indices.size();
+    lod.error = error;
+    for( size_t t = 0; t < s.triangleDead.size(); t++ )
+    {
+        if( s.triangleDead[t] )
+            continue;
+        mesh.indices.push_back(s.triangles[t * 3]);
+        mesh.indices.push_back(s.triangles[t * 3 + 1]);
+        mesh.indices.push_back(s.triangles[t * 3 + 2]);
+    }
+    lod.indexCount = mesh.indices.size() - lod.firstIndex;
+    mesh.lods.push_back(lod);
+}
+
+void buildLods(Mesh &mesh, unsigned int maxLods)
+{
+    const size_t smallest = 64;// triangles, below this a level saves nothing
+
+    mesh.lods.clear();
+    MeshLod full = { 0, (GLuint)mesh.indices.size(), 0.0f };
+    mesh.lods.push_back(full);
+    size_t triangleCount = mesh.indices.size() / 3;
+    if( maxLods < 2 || triangleCount < smallest * 2 )
+        return;
+
+    Simplifier s;
+    size_t vertexCount = mesh.vertices.size();
+    s.positions.resize(vertexCount);
+    for( size_t i = 0; i < vertexCount; i++ )
+    {
+        const GLfloat *position = mesh.vertices[i].position;
+        s.positions[i] = glm::vec3(position[0], position[1], position[2]);
+    }
+    s.triangles.assign(mesh.indices.begin(), mesh.indices.begin() + triangleCount * 3);
+    s.triangleDead.assign(triangleCount, 0);
+    s.vertexTriangles.resize(vertexCount);
+    s.quadrics.resize(vertexCount);
+    s.versions.assign(vertexCount, 0);
+    s.vertexDead.assign(vertexCount, 0);
+    s.border.assign(vertexCount, 0);
+    s.liveTriangles = triangleCount;
+    for( size_t i = 0; i < vertexCount; i++ )
+        quadricClear(s.quadrics[i]);
+
+    //every triangle's plane goes to its three corners
+    for( size_t t = 0; t < triangleCount; t++ )
+    {
+        const GLuint *triangle = &s.triangles[t * 3];
+        glm::vec3 p0 = s.positions[triangle[0]];
+        glm::vec3 normal = glm::cross(s.positions[triangle[1]] - p0, s.positions[triangle[2]] - p0);
+        float area = glm::length(normal);
+        if( area == 0.0f || triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[0] == triangle[2] )
+        {
+            //degenerate in the source, nothing to keep
+            s.triangleDead[t] = 1;
+            s.liveTriangles--;
+            continue;
+        }
+        normal = normal / area;
+        for( int k = 0; k < 3; k++ )
+        {
+            quadricAddPlane(s.quadrics[triangle[k]], normal, -glm::dot(normal, p0), area * 0.5f);
+            s.vertexTriangles[triangle[k]].push_back(t);
+        }
+    }
+
+    //open edges get a plane standing up along them, so sliding a border
+    //vertex off the border costs something
+    std::vector<GLuint> ring;
+    for( size_t t = 0; t < triangleCount; t++ )
+    {
+        if( s.triangleDead[t] )
+            continue;
+        const GLuint *triangle = &s.triangles[t * 3];
+        for( int k = 0; k < 3; k++ )
+        {
+            GLuint a = triangle[k], b = triangle[(k + 1) % 3];
+            if( edgeTriangles(s, a, b) != 1 )
+                continue;
+            s.border[a] = s.border[b] = 1;
+            glm::vec3 p0 = s.positions[triangle[0]];
+            glm::vec3 normal = glm::cross(s.positions[triangle[1]] - p0, s.positions[triangle[2]] - p0);
+            glm::vec3 edge = s.positions[b] - s.positions[a];
+            glm::vec3 side = glm::cross(edge, normal);
+            float length = glm::length(side);
+            if( length == 0.0f )
+                continue;
+            side = side / length;
+            double weight = glm::dot(edge, edge);
+            quadricAddPlane(s.quadrics[a], side, -glm::dot(side, s.positions[a]), weight);
+            quadricAddPlane(s.quadrics[b], side, -glm::dot(side, s.positions[a]), weight);
+        }
+    }
+
+    //queue every edge once, from its lower numbered end
+    for( size_t v = 0; v < vertexCount; v++ )
+    {
+        neighbours(s, v, ring);
+        for( size_t i = 0; i < ring.size(); i++ )
+        {
+            if( ring[i] > v )
+                queueEdge(s, v, ring[i]);
+        }
+    }
+
+    //collapse cheapest first, saving a level every time the count halves
+    std::vector<GLuint> fromRing, toRing;
+    float worst = 0.0f;
+    size_t target = s.liveTriangles / 2;
+    size_t lastLevel = s.liveTriangles;
+    while( mesh.lods.size() < maxLods && !s.queue.empty() )
+    {
+        Collapse collapse = s.queue.top();
+        s.queue.pop();
+        if( s.vertexDead[collapse.from] || s.vertexDead[collapse.to] ||
+            s.versions[collapse.from] != collapse.fromVersion ||
+            s.versions[collapse.to] != collapse.toVersion )
+            continue;
+        if( !canMove(s, collapse.from, collapse.to) ||
+            !collapseAllowed(s, collapse.from, collapse.to, fromRing, toRing) )
+            continue;
+
+        worst = std::max(worst, collapse.error);
+        collapseEdge(s, collapse.from, collapse.to, ring);
+
+        if( s.liveTriangles <= target )
+        {
+            appendLevel(mesh, s, sqrtf(worst));
+            lastLevel = s.liveTriangles;
+            target = s.liveTriangles / 2;
+            if( target < smallest )
+                break;
+        }
+    }
+
+    //ran out of edges that can go, keep what we got if it is worth it
+    if( mesh.lods.size() < maxLods && s.liveTriangles < lastLevel * 3 / 4 )
+        appendLevel(mesh, s, sqrtf(worst));
+}
+
+unsigned int selectLod(const MeshLod *lods, unsigned int lodCount,
+                       float pixelsPerUnit, unsigned int current)
+{
+    if( current >= lodCount )
+        current = lodCount - 1;
+    while( current > 0 && lods[current].error * pixelsPerUnit > LOD_PIXEL_ERROR )
+        current--;
+    while( current + 1 < lodCount &&
+           lods[current + 1].error * pixelsPerUnit < LOD_PIXEL_ERROR * LOD_HYSTERESIS )
+        current++;
+    return current;
+}
@@ -0,0 +1,28 @@
+#ifndef MESHLOD_H
+#define MESHLOD_H
+
+#include "objLoader.h"
+
+//--Levels of detail
+// buildLods simplifies a mesh with quadric error metrics (Garland and
+// Heckbert): edges are collapsed cheapest first, where the cost of a
+// collapse is how far the merged vertex ends up from the planes of the
+// original triangles around it. Vertices only ever collapse onto one of
+// their neighbours, so the simplified levels reuse the mesh's vertices and
+// just append their triangles to the index list.
+
+//Halves the triangle count per level until the mesh is too small to bother
+//or maxLods levels (counting the full mesh) exist
+void buildLods(Mesh &mesh, unsigned int maxLods);
+
+//Picks the level for one object. pixelsPerUnit is how many pixels one
+//model unit covers where the object is, current is the level it was drawn
+//with last frame. A level is good enough while its error stays under
+//LOD_PIXEL_ERROR pixels, and a coarser one is only taken once its error is
+//well under that, so objects sitting near a boundary do not flicker.
+#define LOD_PIXEL_ERROR 1.0f
+#define LOD_HYSTERESIS 0.5f
+unsigned int selectLod(const MeshLod *lods, unsigned int lodCount,
+                       float pixelsPerUnit, unsigned int current);
+
+#endif
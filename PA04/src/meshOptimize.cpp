@@ -0,0 +1,305 @@
+#include "meshOptimize.h"
+#include <algorithm>
+
+CacheStats vertexCacheStats(const GLuint *indices, size_t indexCount,
+                            size_t vertexCount, unsigned int cacheSize)
+{
+    //a vertex is still cached if fewer than cacheSize misses came after it
+    std::vector<size_t> stamps(vertexCount, 0);
+    std::vector<unsigned char> used(vertexCount, 0);
+    size_t misses = 0;
+    size_t unique = 0;
+    for( size_t i = 0; i < indexCount; i++ )
+    {
+        GLuint v = indices[i];
+        if( !used[v] )
+        {
+            used[v] = 1;
+            unique++;
+        }
+        if( stamps[v] == 0 || misses - stamps[v] >= cacheSize )
+        {
+            misses++;
+            stamps[v] = misses;
+        }
+    }
+
+    CacheStats stats;
+    stats.acmr = indexCount ? misses / (indexCount / 3.0f) : 0.0f;
+    stats.atvr = unique ? (float)misses / unique : 0.0f;
+    return stats;
+}
+
+//Next vertex to fan around, the one in the 1-ring that is cached and will
+//stay cached while its triangles are drawn, or a dead end to restart from
+static long nextVertex(const std::vector<GLuint> &ring, const std::vector<long> &stamps,
+                       long time, const std::vector<unsigned int> &live,
+                       std::vector<GLuint> &deadEnds, size_t &cursor,
+                       unsigned int cacheSize)
+{
+    long best = -1;
+    long bestPriority = -1;
+    for( size_t i = 0; i < ring.size(); i++ )
+    {
+        GLuint v = ring[i];
+        if( live[v] == 0 )
+            continue;
+        //fanning v emits at most 2 new vertices per triangle, prefer the
+        //oldest vertex that survives that
+        long priority = 0;
+        if( time - stamps[v] + 2 * (long)live[v] <= (long)cacheSize )
+            priority = time - stamps[v];
+        if( priority > bestPriority )
+        {
+            bestPriority = priority;
+            best = v;
+        }
+    }
+    if( best >= 0 )
+        return best;
+
+    //nothing around, go back to where we left something unfinished
+    while( !deadEnds.empty() )
+    {
+        GLuint v = deadEnds.back();
+        deadEnds.pop_back();
+        if( live[v] > 0 )
+            return v;
+    }
+    while( cursor < live.size() )
+    {
+        if( live[cursor] > 0 )
+            return cursor;
+        cursor++;
+    }
+    return -1;
+}
+
+void optimizeVertexCache(GLuint *indices, size_t indexCount,
+                         size_t vertexCount, unsigned int cacheSize)
+{
+    size_t triangleCount = indexCount / 3;
+    if( triangleCount == 0 )
+        return;
+
+    //triangles around every vertex, packed
+    std::vector<unsigned int> live(vertexCount, 0);
+    for( size_t i = 0; i < triangleCount * 3; i++ )
+        live[indices[i]]++;
+    std::vector<size_t> firstTriangle(vertexCount + 1, 0);
+    for( size_t v = 0; v < vertexCount; v++ )
+        firstTriangle[v + 1] = firstTriangle[v] + live[v];
+    std::vector<GLuint> adjacency(triangleCount * 3);
+    std::vector<size_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+    for( size_t t = 0; t < triangleCount; t++ )
+    {
+        for( int k = 0; k < 3; k++ )
+            adjacency[fill[indices[t * 3 + k]]++] = t;
+    }
+
+    std::vector<GLuint> output;
+    output.reserve(triangleCount * 3);
+    std::vector<unsigned char> emitted(triangleCount, 0);
+    std::vector<long> stamps(vertexCount, 0);
+    std::vector<GLuint> deadEnds;
+    std::vector<GLuint> ring;
+    long time = cacheSize + 1;
+    size_t cursor = 0;
+
+    long fan = nextVertex(ring, stamps, time, live, deadEnds, cursor, cacheSize);
+    while( fan >= 0 )
+    {
+        ring.clear();
+        for( size_t a = firstTriangle[fan]; a < firstTriangle[fan + 1]; a++ )
+        {
+            GLuint t = adjacency[a];
+            if( emitted[t] )
+                continue;
+            emitted[t] = 1;
+            for( int k = 0; k < 3; k++ )
+            {
+                GLuint v = indices[t * 3 + k];
+                output.push_back(v);
+                deadEnds.push_back(v);
+                ring.push_back(v);
+                live[v]--;
+                if( time - stamps[v] > (long)cacheSize )
+                    stamps[v] = time++;
+            }
+        }
+        fan = nextVertex(ring, stamps, time, live, deadEnds, cursor, cacheSize);
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+//A run of triangles drawn together, sorted by how much it faces out
+struct Cluster
+{
+    size_t first;// triangle
+    size_t count;
+    float facing;
+};
+
+static bool facesOutMore(const Cluster &a, const Cluster &b)
+{
+    return a.facing > b.facing;
+}
+
+void optimizeOverdraw(GLuint *indices, size_t indexCount,
+                      const Vertex *vertices, size_t vertexCount,
+                      unsigned int cacheSize, float threshold)
+{
+    size_t triangleCount = indexCount / 3;
+    if( triangleCount == 0 )
+        return;
+
+    //misses per triangle in the current order
+    std::vector<unsigned char> triangleMisses(triangleCount, 0);
+    std::vector<size_t> stamps(vertexCount, 0);
+    size_t misses = 0;
+    for( size_t i = 0; i < triangleCount * 3; i++ )
+    {
+        GLuint v = indices[i];
+        if( stamps[v] == 0 || misses - stamps[v] >= cacheSize )
+        {
+            misses++;
+            stamps[v] = misses;
+            triangleMisses[i / 3]++;
+        }
+    }
+
+    //hard boundaries where all three corners missed, the cache was
+    //starting over there anyway
+    std::vector<size_t> hard;
+    for( size_t t = 0; t < triangleCount; t++ )
+    {
+        if( t == 0 || triangleMisses[t] == 3 )
+            hard.push_back(t);
+    }
+    hard.push_back(triangleCount);
+
+    //soft boundaries inside those, wherever the cluster so far, starting
+    //from an empty cache, is within threshold of the miss rate of the
+    //whole hard cluster
+    std::vector<Cluster> clusters;
+    std::fill(stamps.begin(), stamps.end(), 0);
+    misses = 0;
+    for( size_t h = 0; h + 1 < hard.size(); h++ )
+    {
+        size_t begin = hard[h], end = hard[h + 1];
+        size_t hardMisses = 0;
+        for( size_t t = begin; t < end; t++ )
+            hardMisses += triangleMisses[t];
+        float limit = threshold * hardMisses / (float)(end - begin);
+
+        Cluster cluster = { begin, 0, 0.0f };
+        size_t clusterStart = misses;// anything stamped before this is gone
+        for( size_t t = begin; t < end; t++ )
+        {
+            for( int k = 0; k < 3; k++ )
+            {
+                GLuint v = indices[t * 3 + k];
+                if( stamps[v] <= clusterStart || misses - stamps[v] >= cacheSize )
+                {
+                    misses++;
+                    stamps[v] = misses;
+                }
+            }
+            cluster.count++;
+            if( t + 1 < end && misses - clusterStart <= limit * cluster.count )
+            {
+                clusters.push_back(cluster);
+                cluster.first = t + 1;
+                cluster.count = 0;
+                clusterStart = misses;
+            }
+        }
+        if( cluster.count )
+            clusters.push_back(cluster);
+    }
+
+    //the middle of the mesh, weighted by area
+    glm::vec3 meshCenter(0.0f);
+    float meshArea = 0.0f;
+    std::vector<glm::vec3> centers(triangleCount), normals(triangleCount);
+    for( size_t t = 0; t < triangleCount; t++ )
+    {
+        glm::vec3 p[3];
+        for( int k = 0; k < 3; k++ )
+        {
+            const GLfloat *position = vertices[indices[t * 3 + k]].position;
+            p[k] = glm::vec3(position[0], position[1], position[2]);
+        }
+        normals[t] = glm::cross(p[1] - p[0], p[2] - p[0]);// length is twice the area
+        centers[t] = (p[0] + p[1] + p[2]) / 3.0f;
+        float area = glm::length(normals[t]);
+        meshCenter += centers[t] * area;
+        meshArea += area;
+    }
+    if( meshArea > 0 )
+        meshCenter = meshCenter / meshArea;
+
+    //a cluster faces out when its average normal points away from the middle
+    for( size_t c = 0; c < clusters.size(); c++ )
+    {
+        glm::vec3 center(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for( size_t t = clusters[c].first; t < clusters[c].first + clusters[c].count; t++ )
+        {
+            float triangleArea = glm::length(normals[t]);
+            center += centers[t] * triangleArea;
+            normal += normals[t];
+            area += triangleArea;
+        }
+        float normalLength = glm::length(normal);
+        if( area > 0 && normalLength > 0 )
+            clusters[c].facing = glm::dot(center / area - meshCenter, normal / normalLength);
+    }
+    std::stable_sort(clusters.begin(), clusters.end(), facesOutMore);
+
+    std::vector<GLuint> output;
+    output.reserve(triangleCount * 3);
+    for( size_t c = 0; c < clusters.size(); c++ )
+    {
+        output.insert(output.end(), indices + clusters[c].first * 3,
+                      indices + (clusters[c].first + clusters[c].count) * 3);
+    }
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void optimizeMesh(Mesh &mesh, bool overdraw)
+{
+    std::vector<MeshLod> ranges = mesh.lods;
+    if( ranges.empty() )
+    {
+        MeshLod all = { 0, (GLuint)mesh.indices.size(), 0.0f };
+        ranges.push_back(all);
+    }
+
+    size_t vertexCount = mesh.vertices.size();
+    for( size_t r = 0; r < ranges.size(); r++ )
+    {
+        GLuint *indices = &mesh.indices[0] + ranges[r].firstIndex;
+        size_t count = ranges[r].indexCount;
+        if( r == 0 )
+        {
+            CacheStats stats = vertexCacheStats(indices, count, vertexCount, VERTEX_CACHE_SIZE);
+            mesh.acmrBefore = stats.acmr;
+            mesh.atvrBefore = stats.atvr;
+        }
+
+        optimizeVertexCache(indices, count, vertexCount, VERTEX_CACHE_SIZE);
+        if( overdraw )
+            optimizeOverdraw(indices, count, &mesh.vertices[0], vertexCount,
+                             VERTEX_CACHE_SIZE, OVERDRAW_THRESHOLD);
+
+        if( r == 0 )
+        {
+            CacheStats stats = vertexCacheStats(indices, count, vertexCount, VERTEX_CACHE_SIZE);
+            mesh.acmrAfter = stats.acmr;
+            mesh.atvrAfter = stats.atvr;
+        }
+    }
+    mesh.indexOrder = overdraw ? INDEX_ORDER_OVERDRAW : INDEX_ORDER_VERTEX_CACHE;
+}
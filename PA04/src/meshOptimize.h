@@ -0,0 +1,42 @@
+#ifndef MESHOPTIMIZE_H
+#define MESHOPTIMIZE_H
+
+#include "objLoader.h"
+
+//--Triangle order
+// The GPU keeps the last few transformed vertices around, so triangles that
+// share vertices should be drawn close together. optimizeVertexCache
+// reorders triangles with Tipsify (Sander, Nehab and Barczak 2007), which
+// fans around one vertex at a time and picks the next vertex among the
+// ones still in the cache. optimizeOverdraw then cuts that order into
+// clusters where the cache was flushed anyway and draws the clusters
+// facing out from the middle of the mesh first, so the ones behind them
+// fail the depth test instead of being shaded.
+//
+// Only the index list changes, the vertices stay where they are.
+
+#define VERTEX_CACHE_SIZE 16// entries, a FIFO of this size is what we optimize for
+#define OVERDRAW_THRESHOLD 1.05f// how much worse than Tipsify a cluster may get
+
+//Vertex cache misses of an index list on a FIFO cache
+// ACMR is misses per triangle (0.5 is the best a big regular mesh can do,
+// 3 is no reuse at all) and ATVR is misses per vertex used (1 is perfect)
+struct CacheStats
+{
+    float acmr;
+    float atvr;
+};
+CacheStats vertexCacheStats(const GLuint *indices, size_t indexCount,
+                            size_t vertexCount, unsigned int cacheSize);
+
+void optimizeVertexCache(GLuint *indices, size_t indexCount,
+                         size_t vertexCount, unsigned int cacheSize);
+void optimizeOverdraw(GLuint *indices, size_t indexCount,
+                      const Vertex *vertices, size_t vertexCount,
+                      unsigned int cacheSize, float threshold);
+
+//Reorders every level of detail of a mesh (or the whole index list when
+//there are none) and records the order and the stats of the full mesh
+void optimizeMesh(Mesh &mesh, bool overdraw);
+
+#endif
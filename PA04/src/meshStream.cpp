@@ -0,0 +1,365 @@
+#include "meshStream.h"
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <algorithm>
+
+//Vertex buffers are never split smaller than this (1.5 MB of vertices), or
+//ever more triangles would straddle two of them
+#define MIN_BUFFER_VERTICES 0x10000
+
+//Straddling corners this many vertices apart or closer are read back in one go
+#define READBACK_GAP 256
+
+//Hands pages we are done reading back to the kernel so the file mapping
+//does not quietly grow past the memory cap
+static void dropPages(const char *begin, const char *end)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t first = ((uintptr_t)begin + page - 1) / page * page;
+    uintptr_t last = (uintptr_t)end / page * page;
+    if( last > first )
+        madvise((void*)first, last - first, MADV_DONTNEED);
+}
+
+static void clearGLErrors()
+{
+    while( glGetError() != GL_NO_ERROR )
+        ;
+}
+
+//Creates empty vertex buffers for positionCount vertices, splitting them
+//into several buffers when needed. Returns the number of vertices per
+//buffer, or 0 when even small buffers cannot be allocated.
+static size_t allocateVertexBuffers(size_t positionCount, size_t maxBufferSize,
+                                    std::vector<GLuint> &vbos)
+{
+    size_t perBuffer = maxBufferSize / sizeof(Vertex);
+    if( perBuffer < MIN_BUFFER_VERTICES )
+    {
+        perBuffer = MIN_BUFFER_VERTICES;
+        printf("WARNING: --max-buffer raised to %.1f MB, the smallest buffer the model is split into\n",
+               sizeof(Vertex) * perBuffer / (double)(1 << 20));
+    }
+    while( perBuffer >= MIN_BUFFER_VERTICES )
+    {
+        size_t count = std::max((positionCount + perBuffer - 1) / perBuffer, (size_t)1);
+        vbos.resize(count);
+        glGenBuffers(count, &vbos[0]);
+
+        clearGLErrors();
+        bool allocated = true;
+        for( size_t i = 0; i < count && allocated; i++ )
+        {
+            size_t vertices = std::min(perBuffer, positionCount - i * perBuffer);
+            glBindBuffer(GL_ARRAY_BUFFER, vbos[i]);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices, NULL, GL_STATIC_DRAW);
+            allocated = glGetError() == GL_NO_ERROR;
+        }
+        if( allocated )
+            return perBuffer;
+
+        //the driver would not take buffers this big, try half the size
+        glDeleteBuffers(count, &vbos[0]);
+        vbos.clear();
+        perBuffer /= 2;
+    }
+    return 0;
+}
+
+//--Streaming state
+struct StreamState
+{
+    std::vector<GLuint> vbos;
+    size_t perBuffer;// vertices per vertex buffer
+
+    //vertices waiting to be uploaded, the first one is vertex number
+    //uploaded (everything before it is on the GPU already)
+    std::vector<Vertex> vertices;
+    size_t uploaded;
+    size_t vertexLimit;
+
+    //indices waiting to be uploaded, one list per vertex buffer
+    std::vector< std::vector<GLuint> > indices;
+    size_t indexLimit;
+
+    //triangles with corners in different vertex buffers (global indices),
+    //flushed when the list reaches straddlerLimit
+    std::vector<GLuint> straddlers;
+    size_t straddlerLimit;
+
+    std::vector<DrawBatch> *batches;
+};
+
+static void flushVertices(StreamState &state)
+{
+    size_t done = 0;
+    while( done < state.vertices.size() )
+    {
+        size_t vertex = state.uploaded + done;
+        size_t buffer = vertex / state.perBuffer;
+        size_t local = vertex % state.perBuffer;
+        size_t count = std::min(state.vertices.size() - done, state.perBuffer - local);
+
+        glBindBuffer(GL_ARRAY_BUFFER, state.vbos[buffer]);
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(Vertex) * local,
+                        sizeof(Vertex) * count, &state.vertices[done]);
+        done += count;
+    }
+    state.uploaded += state.vertices.size();
+    state.vertices.clear();
+}
+
+//Every flush of the indices becomes its own index buffer and batch
+static void flushIndices(StreamState &state, const std::vector<GLuint> &indices, GLuint vbo)
+{
+    if( indices.empty() )
+        return;
+
+    DrawBatch batch;
+    batch.vbo = vbo;
+    batch.count = indices.size();
+    batch.indexType = GL_UNSIGNED_INT;
+    glGenBuffers(1, &batch.ibo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch.ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indices.size(), &indices[0], GL_STATIC_DRAW);
+    state.batches->push_back(batch);
+}
+
+//Copies the corners of straddling triangles into a batch of their own.
+//Corners still waiting on the host are copied from there and the rest are
+//read back from the vertex buffers, each run of nearby vertices with one
+//glGetBufferSubData. Triangles with corners not parsed yet stay in the
+//list for later.
+static void flushStraddlers(StreamState &state)
+{
+    size_t parsed = state.uploaded + state.vertices.size();
+    std::vector<GLuint> ready;
+    std::vector<GLuint> waiting;
+    for( size_t t = 0; t < state.straddlers.size(); t += 3 )
+    {
+        const GLuint *corners = &state.straddlers[t];
+        if( corners[0] >= parsed || corners[1] >= parsed || corners[2] >= parsed )
+            waiting.insert(waiting.end(), corners, corners + 3);
+        else
+            ready.insert(ready.end(), corners, corners + 3);
+    }
+    state.straddlers.swap(waiting);
+    if( ready.empty() )
+        return;
+
+    //every vertex once and in order, so nearby ones are read back together
+    std::vector<GLuint> used(ready);
+    std::sort(used.begin(), used.end());
+    used.erase(std::unique(used.begin(), used.end()), used.end());
+    std::vector<Vertex> vertices(used.size());
+    std::vector<Vertex> run;
+    size_t u = 0;
+    while( u < used.size() )
+    {
+        if( used[u] >= state.uploaded )
+        {
+            vertices[u] = state.vertices[used[u] - state.uploaded];
+            u++;
+            continue;
+        }
+        //a run stays in one buffer, skips small gaps and fits the vertex budget
+        size_t first = used[u], buffer = first / state.perBuffer, last = u;
+        while( last + 1 < used.size() && used[last + 1] < state.uploaded &&
+               used[last + 1] / state.perBuffer == buffer &&
+               used[last + 1] - used[last] <= READBACK_GAP &&
+               used[last + 1] - first < state.vertexLimit )
+            last++;
+        run.resize(used[last] - first + 1);
+        glBindBuffer(GL_ARRAY_BUFFER, state.vbos[buffer]);
+        glGetBufferSubData(GL_ARRAY_BUFFER, sizeof(Vertex) * (first % state.perBuffer),
+                           sizeof(Vertex) * run.size(), &run[0]);
+        for( ; u <= last; u++ )
+            vertices[u] = run[used[u] - first];
+    }
+
+    std::vector<GLuint> indices(ready.size());
+    for( size_t i = 0; i < ready.size(); i++ )
+        indices[i] = std::lower_bound(used.begin(), used.end(), ready[i]) - used.begin();
+
+    GLuint vbo;
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices.size(), &vertices[0], GL_STATIC_DRAW);
+    flushIndices(state, indices, vbo);
+}
+
+bool streamOBJ(const char *fileName, const StreamOptions &options,
+               std::vector<DrawBatch> &batches,
+               glm::vec3 &boundsMin, glm::vec3 &boundsMax)
+{
+    batches.clear();
+    boundsMin = glm::vec3(0.0f);
+    boundsMax = glm::vec3(0.0f);
+
+    MappedFile file;
+    if( !mapFile(fileName, file) )
+    {
+        printf("ERROR: Object file not found!!");
+        return false;
+    }
+    const char *begin = file.data;
+    const char *end = file.data + file.size;
+
+    //First pass, count the positions so the vertex buffers can be sized
+    size_t positionCount = countOBJPositions(begin, end);
+    dropPages(begin, end);
+
+    StreamState state;
+    state.batches = &batches;
+    state.uploaded = 0;
+    state.perBuffer = allocateVertexBuffers(positionCount, options.maxBufferSize, state.vbos);
+    if( state.perBuffer == 0 )
+    {
+        printf("ERROR: Could not allocate vertex buffers!!");
+        unmapFile(file);
+        return false;
+    }
+
+    //Split the memory budget: a quarter each for vertices and indices
+    //waiting to be uploaded, and a window of the file small enough that
+    //parsing it stays well inside the rest
+    size_t window = std::max(options.memoryCap / 32, (size_t)(64 * 1024));
+    state.vertexLimit = std::max(options.memoryCap / 4 / sizeof(Vertex), (size_t)1024);
+    state.indexLimit = std::max(options.memoryCap / 4 / sizeof(GLuint) / state.vbos.size(), (size_t)3072) / 3 * 3;
+    state.indices.resize(state.vbos.size());
+    state.straddlerLimit = state.indexLimit;
+
+    std::vector<glm::vec3> positions;
+    std::vector<GLuint> faceIndices;
+    size_t positionOffset = 0;
+    unsigned int colorState = (unsigned int)time(NULL) | 1;
+    bool ok = true;
+
+    //Second pass, a window of the file at a time
+    const char *p = begin;
+    while( ok && p < end )
+    {
+        const char *windowEnd = alignToLine(p + std::min(window, (size_t)(end - p)), p, end);
+        positions.clear();
+        faceIndices.clear();
+        if( !parseOBJRange(p, windowEnd, positions, faceIndices) )
+        {
+            ok = false;
+            break;
+        }
+
+        for( size_t i = 0; i < positions.size(); i++ )
+        {
+            const glm::vec3 &tmpVec = positions[i];
+            Vertex newVertex;
+            newVertex.position[0] = (fabs(tmpVec.x) < 1e-20)? 0 : tmpVec.x;
+            newVertex.position[1] = (fabs(tmpVec.y) < 1e-20)? 0 : tmpVec.y;
+            newVertex.position[2] = (fabs(tmpVec.z) < 1e-20)? 0 : tmpVec.z;
+            newVertex.color[0] = randomColor(colorState);
+            newVertex.color[1] = randomColor(colorState);
+            newVertex.color[2] = randomColor(colorState);
+
+            glm::vec3 position(newVertex.position[0], newVertex.position[1], newVertex.position[2]);
+            if( state.uploaded == 0 && state.vertices.empty() )
+            {
+                boundsMin = position;
+                boundsMax = position;
+            }
+            boundsMin = glm::min(boundsMin, position);
+            boundsMax = glm::max(boundsMax, position);
+
+            state.vertices.push_back(newVertex);
+            if( state.vertices.size() >= state.vertexLimit )
+                flushVertices(state);
+        }
+
+        for( size_t t = 0; ok && t < faceIndices.size(); t += 3 )
+        {
+            long corners[3];
+            for( int c = 0; c < 3; c++ )
+            {
+                corners[c] = resolveOBJIndex(faceIndices[t + c], positionOffset);
+                if( corners[c] < 0 || corners[c] >= (long)positionCount )
+                    ok = false;
+            }
+            if( !ok )
+                break;
+
+            size_t buffer = corners[0] / state.perBuffer;
+            if( (size_t)corners[1] / state.perBuffer == buffer &&
+                (size_t)corners[2] / state.perBuffer == buffer )
+            {
+                std::vector<GLuint> &indices = state.indices[buffer];
+                for( int c = 0; c < 3; c++ )
+                    indices.push_back(corners[c] - buffer * state.perBuffer);
+                if( indices.size() >= state.indexLimit )
+                {
+                    flushIndices(state, indices, state.vbos[buffer]);
+                    indices.clear();
+                }
+            }
+            else
+            {
+                for( int c = 0; c < 3; c++ )
+                    state.straddlers.push_back(corners[c]);
+                if( state.straddlers.size() >= state.straddlerLimit )
+                {
+                    //the ones that still wait on later vertices get another
+                    //indexLimit of company before the list is scanned again
+                    flushStraddlers(state);
+                    state.straddlerLimit = state.straddlers.size() + state.indexLimit;
+                }
+            }
+        }
+
+        positionOffset += positions.size();
+        dropPages(p, windowEnd);
+        p = windowEnd;
+    }
+    unmapFile(file);
+
+    //Upload whatever is left over
+    if( ok )
+    {
+        flushVertices(state);
+        for( size_t i = 0; i < state.indices.size(); i++ )
+            flushIndices(state, state.indices[i], state.vbos[i]);
+        flushStraddlers(state);
+    }
+
+    //vertex buffers no triangle ended up using
+    for( size_t i = 0; i < state.vbos.size(); i++ )
+    {
+        bool referenced = false;
+        for( size_t b = 0; b < batches.size() && !referenced; b++ )
+            referenced = batches[b].vbo == state.vbos[i];
+        if( !referenced )
+            glDeleteBuffers(1, &state.vbos[i]);
+    }
+
+    if( !ok )
+    {
+        printf("ERROR: Object file is malformed!!");
+        deleteBatches(batches);
+        return false;
+    }
+    return true;
+}
+
+void deleteBatches(std::vector<DrawBatch> &batches)
+{
+    std::vector<GLuint> buffers;
+    for( size_t i = 0; i < batches.size(); i++ )
+    {
+        buffers.push_back(batches[i].vbo);
+        buffers.push_back(batches[i].ibo);
+    }
+    std::sort(buffers.begin(), buffers.end());
+    buffers.erase(std::unique(buffers.begin(), buffers.end()), buffers.end());
+    if( !buffers.empty() )
+        glDeleteBuffers(buffers.size(), &buffers[0]);
+    batches.clear();
+}
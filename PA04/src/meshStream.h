@@ -0,0 +1,41 @@
+#ifndef MESHSTREAM_H
+#define MESHSTREAM_H
+
+#include "objLoader.h"
+
+//A piece of the model that is drawn with one glDrawElements call
+// several batches can share a vertex buffer
+struct DrawBatch
+{
+    GLuint vbo;
+    GLuint ibo;
+    GLsizei count;// number of indices
+    GLenum indexType;
+};
+
+//--Out of core loading
+// For models that do not fit in memory. The file is parsed a window at a
+// time and each finished piece goes to the GPU with glBufferSubData, so
+// the whole model never exists on the host at once. Vertices are not
+// deduplicated: every "v" line becomes one vertex.
+//
+// Vertices are split over several buffers when one buffer would be larger
+// than maxBufferSize or the driver refuses the allocation. Triangles whose
+// corners end up in different buffers are gathered into extra batches.
+// Those that refer to vertices further on in the file wait on the host
+// until the vertices are parsed, so a file that defines its vertices after
+// its faces can go over memoryCap.
+struct StreamOptions
+{
+    size_t memoryCap;// host memory budget in bytes (roughly)
+    size_t maxBufferSize;// largest single buffer in bytes
+};
+
+bool streamOBJ(const char *fileName, const StreamOptions &options,
+               std::vector<DrawBatch> &batches,
+               glm::vec3 &boundsMin, glm::vec3 &boundsMax);
+
+//Deletes the buffers of every batch (shared buffers only once)
+void deleteBatches(std::vector<DrawBatch> &batches);
+
+#endif
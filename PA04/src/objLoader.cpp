@@ -0,0 +1,647 @@
+#include "objLoader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//--Memory mapped files
+// The whole OBJ is mapped read only and the tokenizer walks the bytes
+// directly, so there is no copying into line buffers or strings
+bool mapFile(const char *fileName, MappedFile &file)
+{
+    file.data = NULL;
+    file.size = 0;
+
+    int fd = open(fileName, O_RDONLY);
+    if( fd < 0 )
+        return false;
+
+    struct stat info;
+    if( fstat(fd, &info) != 0 )
+    {
+        close(fd);
+        return false;
+    }
+
+    file.size = info.st_size;
+    if( file.size > 0 )
+    {
+        void *addr = mmap(NULL, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if( addr == MAP_FAILED )
+        {
+            close(fd);
+            return false;
+        }
+        //we only ever walk forward through the file
+        madvise(addr, file.size, MADV_SEQUENTIAL);
+        file.data = static_cast<const char*>(addr);
+    }
+
+    //the mapping stays valid after the descriptor is closed
+    close(fd);
+    return true;
+}
+
+void unmapFile(MappedFile &file)
+{
+    if( file.data )
+        munmap(const_cast<char*>(file.data), file.size);
+    file.data = NULL;
+    file.size = 0;
+}
+
+//--Tokenizer helpers
+// None of these allocate, they all take the end of the buffer since the
+// mapping is not null terminated
+
+//skips spaces and tabs (and the \r of windows line endings)
+static inline const char* skipSpace(const char *p, const char *end)
+{
+    while( p < end && (*p == ' ' || *p == '\t' || *p == '\r') )
+        p++;
+    return p;
+}
+
+//moves to the first character of the next line
+static inline const char* skipLine(const char *p, const char *end)
+{
+    const char *nl = static_cast<const char*>(memchr(p, '\n', end - p));
+    return nl ? nl + 1 : end;
+}
+
+//moves past the rest of the current token
+static inline const char* skipToken(const char *p, const char *end)
+{
+    while( p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n' )
+        p++;
+    return p;
+}
+
+static inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+//parses a (possibly negative) integer, returns NULL if there is none
+static inline const char* parseInt(const char *p, const char *end, long &out)
+{
+    bool negative = false;
+    if( p < end && (*p == '-' || *p == '+') )
+    {
+        negative = (*p == '-');
+        p++;
+    }
+    if( p >= end || !isDigit(*p) )
+        return NULL;
+
+    long value = 0;
+    while( p < end && isDigit(*p) )
+    {
+        value = value * 10 + (*p - '0');
+        p++;
+    }
+    out = negative ? -value : value;
+    return p;
+}
+
+//parses a float in plain or scientific notation
+// anything odd (inf, nan, huge mantissas) is handed to strtod instead
+static const char* parseFloat(const char *p, const char *end, float &out)
+{
+    static const double powersOf10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+        1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+        1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+    const char *start = p;
+    bool negative = false;
+    if( p < end && (*p == '-' || *p == '+') )
+    {
+        negative = (*p == '-');
+        p++;
+    }
+
+    unsigned long long mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any = false;
+
+    while( p < end && isDigit(*p) )
+    {
+        if( digits < 19 )
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            if( mantissa )
+                digits++;
+        }
+        else
+        {
+            exponent++;
+        }
+        any = true;
+        p++;
+    }
+    if( p < end && *p == '.' )
+    {
+        p++;
+        while( p < end && isDigit(*p) )
+        {
+            if( digits < 19 )
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                if( mantissa )
+                    digits++;
+                exponent--;
+            }
+            any = true;
+            p++;
+        }
+    }
+    if( any && p < end && (*p == 'e' || *p == 'E') )
+    {
+        long e;
+        const char *q = parseInt(p + 1, end, e);
+        if( q )
+        {
+            exponent += (int)e;
+            p = q;
+        }
+    }
+
+    if( !any || exponent < -22 || exponent > 22 )
+    {
+        //slow path, copy the token out so strtod has a terminator
+        char buff[64];
+        const char *tokenEnd = skipToken(start, end);
+        size_t length = tokenEnd - start;
+        if( length == 0 || length >= sizeof(buff) )
+            return NULL;
+        memcpy(buff, start, length);
+        buff[length] = '\0';
+        char *parsedEnd;
+        out = (float)strtod(buff, &parsedEnd);
+        if( parsedEnd == buff )
+            return NULL;
+        return start + (parsedEnd - buff);
+    }
+
+    double value = (double)mantissa;
+    if( exponent < 0 )
+        value /= powersOf10[-exponent];
+    else
+        value *= powersOf10[exponent];
+    out = (float)(negative ? -value : value);
+    return p;
+}
+
+//--Parsing
+// The file is cut into line aligned chunks that are parsed on separate
+// threads. A chunk does not know how many positions came before it, so
+// positive indices are stored as they are (0 based) and negative ones
+// are stored relative to the chunk's first position with the top bit
+// set. The merge adds each chunk's offset once the counts are known.
+const GLuint CHUNK_RELATIVE = 0x80000000;
+
+struct ParseChunk
+{
+    const char *begin;
+    const char *end;
+    bool parsed;
+
+    std::vector<glm::vec3> positions;
+    std::vector<GLuint> indices;
+
+    //filled in by the merge
+    size_t positionOffset;// global number of the first position
+    size_t indexOffset;// where the indices go in the mesh
+    size_t vertexOffset;// where the used positions go in the mesh
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+};
+
+static inline GLuint encodeIndex(long index, long count)
+{
+    //negative indices are relative to the end of the list
+    if( index < 0 )
+        return CHUNK_RELATIVE | ((GLuint)(count + index) & ~CHUNK_RELATIVE);
+    return (GLuint)(index - 1);
+}
+
+long resolveOBJIndex(GLuint index, size_t positionOffset)
+{
+    if( index & CHUNK_RELATIVE )
+    {
+        //sign extend the 31 bit relative index
+        long relative = (long)(int)(index << 1) >> 1;
+        return (long)positionOffset + relative;
+    }
+    return (long)index;
+}
+
+// Reads the positions and the triangulated faces of one chunk
+bool parseOBJRange(const char *p, const char *end,
+                     std::vector<glm::vec3> &positions,
+                     std::vector<GLuint> &vertexIndices)
+{
+    while( p < end )
+    {
+        p = skipSpace(p, end);
+        if( p >= end )
+            break;
+
+        //get vertices
+        if( p[0] == 'v' && p + 1 < end && (p[1] == ' ' || p[1] == '\t') )
+        {
+            glm::vec3 vertex;
+            p += 2;
+            for( int i = 0; i < 3; i++ )
+            {
+                p = parseFloat(skipSpace(p, end), end, vertex[i]);
+                if( !p )
+                    return false;
+            }
+            positions.push_back(vertex);
+        }
+
+        //get faces
+        else if( p[0] == 'f' && p + 1 < end && (p[1] == ' ' || p[1] == '\t') )
+        {
+            long count = (long)positions.size();
+            GLuint first = 0, previous = 0;
+            int corners = 0;
+            p += 2;
+
+            while( true )
+            {
+                p = skipSpace(p, end);
+                if( p >= end || *p == '\n' || *p == '#' )
+                    break;
+
+                long index;
+                const char *q = parseInt(p, end, index);
+                if( !q || index == 0 )
+                    return false;
+                //a positive index past 2^31 would have the relative bit
+                //set and be read back as a negative one
+                if( index > (long)CHUNK_RELATIVE || index < -(long)CHUNK_RELATIVE )
+                    return false;
+                //only the position index is used, skip the /vt/vn part
+                p = skipToken(q, end);
+                GLuint current = encodeIndex(index, count);
+
+                //Triangulate the face as a fan around the first corner
+                if( corners == 0 )
+                    first = current;
+                else if( corners >= 2 )
+                {
+                    vertexIndices.push_back(first);
+                    vertexIndices.push_back(previous);
+                    vertexIndices.push_back(current);
+                }
+                previous = current;
+                corners++;
+            }
+        }
+
+        //junk? or something we haven't learned yet
+        p = skipLine(p, end);
+    }
+    return true;
+}
+
+size_t countOBJPositions(const char *p, const char *end)
+{
+    size_t count = 0;
+    while( p < end )
+    {
+        p = skipSpace(p, end);
+        if( p + 1 < end && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t') )
+            count++;
+        p = skipLine(p, end);
+    }
+    return count;
+}
+
+const char* alignToLine(const char *p, const char *begin, const char *end)
+{
+    if( p <= begin )
+        return begin;
+    if( p >= end )
+        return end;
+    return skipLine(p - 1, end);
+}
+
+//--Threads
+static unsigned int loaderThreadCount(size_t bytes)
+{
+    unsigned int threads = std::thread::hardware_concurrency();
+    if( threads == 0 )
+        threads = 1;
+    //not worth waking a thread for less than a couple of megabytes
+    size_t useful = bytes / (2 << 20) + 1;
+    if( threads > useful )
+        threads = useful;
+    return threads;
+}
+
+//runs work(thread) on every thread, including this one, and waits
+template <typename Work>
+static void runThreads(unsigned int threads, Work work)
+{
+    std::vector<std::thread> pool;
+    for( unsigned int t = 1; t < threads; t++ )
+        pool.push_back(std::thread(work, t));
+    work(0);
+    for( unsigned int t = 0; t < pool.size(); t++ )
+        pool[t].join();
+}
+
+bool loadOBJ(const char * fileName, Mesh &mesh)
+{
+    mesh.vertices.clear();
+    mesh.indices.clear();
+    mesh.lods.clear();
+    mesh.indexOrder = INDEX_ORDER_FILE;
+    mesh.acmrBefore = mesh.acmrAfter = 0.0f;
+    mesh.atvrBefore = mesh.atvrAfter = 0.0f;
+
+    MappedFile file;
+    if( !mapFile(fileName, file) )
+    {
+        printf("ERROR: Object file not found!!");
+        return false;
+    }
+
+    //Split the file into line aligned chunks
+    // there are a few per thread so a thread that gets a slow part of the
+    // file (vertices parse slower than faces) does not hold up the rest
+    unsigned int threads = loaderThreadCount(file.size);
+    unsigned int chunkCount = threads == 1 ? 1 : threads * 4;
+    std::vector<ParseChunk> chunks(chunkCount);
+    const char *fileEnd = file.data + file.size;
+    const char *chunkStart = file.data;
+    for( unsigned int c = 0; c < chunkCount; c++ )
+    {
+        const char *chunkEnd = file.data + file.size / chunkCount * (c + 1);
+        if( c == chunkCount - 1 || chunkEnd >= fileEnd )
+            chunkEnd = fileEnd;
+        else
+            chunkEnd = alignToLine(chunkEnd < chunkStart ? chunkStart : chunkEnd,
+                                   chunkStart, fileEnd);
+        chunks[c].begin = chunkStart;
+        chunks[c].end = chunkEnd;
+        chunkStart = chunkEnd;
+    }
+
+    //Parse every chunk into its own buffers
+    std::atomic<unsigned int> nextChunk(0);
+    runThreads(threads, [&](unsigned int)
+    {
+        for( unsigned int c = nextChunk++; c < chunkCount; c = nextChunk++ )
+        {
+            ParseChunk &chunk = chunks[c];
+            size_t bytes = chunk.end - chunk.begin;
+            //rough guesses from the size so we do not keep regrowing
+            chunk.positions.reserve(bytes / 96);
+            chunk.indices.reserve(bytes / 8);
+            chunk.parsed = parseOBJRange(chunk.begin, chunk.end,
+                                    chunk.positions, chunk.indices);
+        }
+    });
+    unmapFile(file);
+
+    //Prefix sums give every chunk its place in the merged arrays
+    size_t positionCount = 0, indexCount = 0;
+    bool parsed = true;
+    for( unsigned int c = 0; c < chunkCount; c++ )
+    {
+        chunks[c].positionOffset = positionCount;
+        chunks[c].indexOffset = indexCount;
+        positionCount += chunks[c].positions.size();
+        indexCount += chunks[c].indices.size();
+        parsed = parsed && chunks[c].parsed;
+    }
+    if( !parsed || positionCount >= CHUNK_RELATIVE )
+    {
+        printf("ERROR: Object file is malformed!!");
+        return false;
+    }
+
+    //Merge the indices, resolve them to global positions and note which
+    //positions are used by a face
+    mesh.indices.resize(indexCount);
+    std::unique_ptr< std::atomic<unsigned char>[] > used(new std::atomic<unsigned char>[positionCount]());
+    std::atomic<bool> inRange(true);
+    nextChunk = 0;
+    runThreads(threads, [&](unsigned int)
+    {
+        for( unsigned int c = nextChunk++; c < chunkCount; c = nextChunk++ )
+        {
+            ParseChunk &chunk = chunks[c];
+            GLuint *out = indexCount ? &mesh.indices[chunk.indexOffset] : NULL;
+            for( size_t i = 0; i < chunk.indices.size(); i++ )
+            {
+                long index = resolveOBJIndex(chunk.indices[i], chunk.positionOffset);
+                if( index < 0 || index >= (long)positionCount )
+                {
+                    inRange = false;
+                    break;
+                }
+                out[i] = (GLuint)index;
+                used[index].store(1, std::memory_order_relaxed);
+            }
+            std::vector<GLuint>().swap(chunk.indices);
+        }
+    });
+    if( !inRange )
+    {
+        printf("ERROR: Object file is malformed!!");
+        return false;
+    }
+
+    //Deduplicate the vertices
+    // every used position becomes exactly one vertex, in file order, and
+    // positions no face refers to are dropped
+    std::vector<GLuint> remap(positionCount);
+    nextChunk = 0;
+    runThreads(threads, [&](unsigned int)
+    {
+        for( unsigned int c = nextChunk++; c < chunkCount; c = nextChunk++ )
+        {
+            ParseChunk &chunk = chunks[c];
+            size_t usedCount = 0;
+            for( size_t i = 0; i < chunk.positions.size(); i++ )
+                usedCount += used[chunk.positionOffset + i].load(std::memory_order_relaxed);
+            chunk.vertexOffset = usedCount;
+        }
+    });
+
+    size_t vertexCount = 0;
+    for( unsigned int c = 0; c < chunkCount; c++ )
+    {
+        size_t usedCount = chunks[c].vertexOffset;
+        chunks[c].vertexOffset = vertexCount;
+        vertexCount += usedCount;
+    }
+    mesh.vertices.resize(vertexCount);
+
+    unsigned int seed = (unsigned int)time(NULL);
+    nextChunk = 0;
+    runThreads(threads, [&](unsigned int)
+    {
+        for( unsigned int c = nextChunk++; c < chunkCount; c = nextChunk++ )
+        {
+            ParseChunk &chunk = chunks[c];
+            unsigned int colorState = (seed + c * 2654435761u) | 1;
+            size_t next = chunk.vertexOffset;
+            bool first = true;
+            for( size_t i = 0; i < chunk.positions.size(); i++ )
+            {
+                if( !used[chunk.positionOffset + i].load(std::memory_order_relaxed) )
+                    continue;
+
+                const glm::vec3 &tmpVec = chunk.positions[i];
+                Vertex &newVertex = mesh.vertices[next];
+                newVertex.position[0] = (fabs(tmpVec.x) < 1e-20)? 0 : tmpVec.x;
+                newVertex.position[1] = (fabs(tmpVec.y) < 1e-20)? 0 : tmpVec.y;
+                newVertex.position[2] = (fabs(tmpVec.z) < 1e-20)? 0 : tmpVec.z;
+                newVertex.color[0] = randomColor(colorState);
+                newVertex.color[1] = randomColor(colorState);
+                newVertex.color[2] = randomColor(colorState);
+
+                glm::vec3 position(newVertex.position[0], newVertex.position[1], newVertex.position[2]);
+                if( first )
+                {
+                    chunk.boundsMin = position;
+                    chunk.boundsMax = position;
+                    first = false;
+                }
+                chunk.boundsMin = glm::min(chunk.boundsMin, position);
+                chunk.boundsMax = glm::max(chunk.boundsMax, position);
+
+                remap[chunk.positionOffset + i] = next++;
+            }
+            if( first )
+                chunk.boundsMin = chunk.boundsMax = glm::vec3(0.0f);
+            std::vector<glm::vec3>().swap(chunk.positions);
+        }
+    });
+
+    //Point the indices at the deduplicated vertices
+    runThreads(threads, [&](unsigned int t)
+    {
+        size_t begin = indexCount / threads * t;
+        size_t end = (t == threads - 1) ? indexCount : indexCount / threads * (t + 1);
+        for( size_t i = begin; i < end; i++ )
+            mesh.indices[i] = remap[mesh.indices[i]];
+    });
+
+    mesh.boundsMin = glm::vec3(0.0f);
+    mesh.boundsMax = glm::vec3(0.0f);
+    bool first = true;
+    for( unsigned int c = 0; c < chunkCount; c++ )
+    {
+        //chunks without a used position have nothing to add
+        if( c + 1 < chunkCount ? chunks[c + 1].vertexOffset == chunks[c].vertexOffset
+                               : vertexCount == chunks[c].vertexOffset )
+            continue;
+        if( first )
+        {
+            mesh.boundsMin = chunks[c].boundsMin;
+            mesh.boundsMax = chunks[c].boundsMax;
+            first = false;
+        }
+        mesh.boundsMin = glm::min(mesh.boundsMin, chunks[c].boundsMin);
+        mesh.boundsMax = glm::max(mesh.boundsMax, chunks[c].boundsMax);
+    }
+
+    //Bounding sphere around the center of the box, the radius is the
+    //farthest vertex (tighter than the corner of the box)
+    mesh.sphereCenter = (mesh.boundsMin + mesh.boundsMax) * 0.5f;
+    std::vector<float> farthest(threads, 0.0f);
+    runThreads(threads, [&](unsigned int t)
+    {
+        size_t begin = vertexCount / threads * t;
+        size_t end = (t == threads - 1) ? vertexCount : vertexCount / threads * (t + 1);
+        float best = 0.0f;
+        for( size_t i = begin; i < end; i++ )
+        {
+            const GLfloat *position = mesh.vertices[i].position;
+            float dx = position[0] - mesh.sphereCenter.x;
+            float dy = position[1] - mesh.sphereCenter.y;
+            float dz = position[2] - mesh.sphereCenter.z;
+            best = std::max(best, dx * dx + dy * dy + dz * dz);
+        }
+        farthest[t] = best;
+    });
+    mesh.sphereRadius = sqrtf(*std::max_element(farthest.begin(), farthest.end()));
+
+    return true;
+}
+
+GLenum meshIndexType(const Mesh &mesh)
+{
+    //16 bit indices can address 65536 vertices
+    if( mesh.vertices.size() <= 0x10000 )
+        return GL_UNSIGNED_SHORT;
+    return GL_UNSIGNED_INT;
+}
+
+void packVertices(const Vertex *vertices, size_t count,
+                  const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+                  PackedVertex *packed)
+{
+    //a flat axis has no extent, everything on it packs to 0
+    float scale[3];
+    for( int k = 0; k < 3; k++ )
+    {
+        float extent = boundsMax[k] - boundsMin[k];
+        scale[k] = extent > 0 ? 65535.0f / extent : 0.0f;
+    }
+
+    for( size_t i = 0; i < count; i++ )
+    {
+        for( int k = 0; k < 3; k++ )
+        {
+            float q = (vertices[i].position[k] - boundsMin[k]) * scale[k] + 0.5f;
+            packed[i].position[k] = (GLushort)std::min(std::max(q, 0.0f), 65535.0f);
+            float c = vertices[i].color[k] * 255.0f + 0.5f;
+            packed[i].color[k] = (GLubyte)std::min(std::max(c, 0.0f), 255.0f);
+        }
+        packed[i].padding = 0;
+        packed[i].color[3] = 255;
+    }
+}
+
+void split(const std::string &s, std::vector<unsigned int> &elems)
+{
+    elems.clear();
+    std::istringstream is( s );
+    unsigned int n;
+	if( s.find('/',0) != std::string::npos )
+	{
+		std::string dummy;
+		while( is >> n )
+		{
+			elems.push_back(n);
+			is >> dummy;
+		}
+	}
+	else
+	{
+		while( is >> n )
+		{
+		     elems.push_back(n);
+		}
+	}
+}
@@ -0,0 +1,122 @@
+#ifndef OBJLOADER_H
+#define OBJLOADER_H
+
+#include <GL/glew.h> // glew must be included before the main gl libs
+#include <vector>
+#include <string>
+#include <glm/glm.hpp>
+
+//--Data types
+//This object will define the attributes of a vertex(position, color, etc...)
+struct Vertex
+{
+    GLfloat position[3];
+    GLfloat color[3];
+};
+
+//The compact layout, 12 bytes instead of 24. Positions are 16 bit fractions
+//of the mesh's bounding box (the vertex shader maps them back with
+//positionScale and positionOffset) and colors are 8 bits a channel.
+struct PackedVertex
+{
+    GLushort position[3];
+    GLushort padding;// keeps the color 4 byte aligned
+    GLubyte color[4];// rgba
+};
+
+//Triangle orders, file order is whatever the OBJ had
+enum IndexOrder
+{
+    INDEX_ORDER_FILE,
+    INDEX_ORDER_VERTEX_CACHE,
+    INDEX_ORDER_OVERDRAW
+};
+
+//One level of detail, a range of the mesh's index list. Every level
+//draws from the same vertices.
+#define MAX_LODS 8
+struct MeshLod
+{
+    GLuint firstIndex;
+    GLuint indexCount;
+    float error;// how far the surface may have moved, in model units
+};
+
+//Indexed geometry
+// every vertex is stored once and the triangles refer to them by index
+struct Mesh
+{
+    std::vector<Vertex> vertices;
+    std::vector<GLuint> indices;
+    std::vector<MeshLod> lods;// empty until buildLods, then lods[0] is the full mesh
+    glm::vec3 boundsMin;// axis aligned box around every vertex
+    glm::vec3 boundsMax;
+    glm::vec3 sphereCenter;// and a sphere, centered on the box
+    float sphereRadius;
+
+    //how the triangles are ordered, and the vertex cache misses of the
+    //full mesh before and after (see meshOptimize.h)
+    unsigned int indexOrder;
+    float acmrBefore, acmrAfter;
+    float atvrBefore, atvrAfter;
+};
+
+//--Memory mapped files
+struct MappedFile
+{
+    const char *data;
+    size_t size;
+};
+
+//Maps a whole file read only, an empty file maps to a NULL data pointer
+bool mapFile(const char *fileName, MappedFile &file);
+void unmapFile(MappedFile &file);
+
+//OBJ loader
+// Maps the file into memory and tokenizes it in place, only the
+// "v" and "f" lines are used, everything else is skipped. Large files
+// are parsed in chunks on every core.
+bool loadOBJ(const char * fileName, Mesh &mesh);
+
+//--Pieces of the loader
+// used by the streaming loader, which parses a window of the file at a time
+
+//Parses a line aligned range of an OBJ file. Face indices come out 0 based
+//except negative (relative) ones, which need resolveOBJIndex with the
+//number of positions that came before the range.
+bool parseOBJRange(const char *begin, const char *end,
+                   std::vector<glm::vec3> &positions,
+                   std::vector<GLuint> &indices);
+long resolveOBJIndex(GLuint index, size_t positionOffset);
+
+//Number of "v" lines in a range
+size_t countOBJPositions(const char *begin, const char *end);
+
+//Moves p forward to the start of a line (begin and end are left alone)
+const char* alignToLine(const char *p, const char *begin, const char *end);
+
+//Smallest index type (GL_UNSIGNED_SHORT or GL_UNSIGNED_INT) that can
+//address every vertex of the mesh
+GLenum meshIndexType(const Mesh &mesh);
+
+//Quantizes vertices into the compact layout. Positions are stored relative
+//to the box (boundsMin, boundsMax), which has to hold all of them.
+void packVertices(const Vertex *vertices, size_t count,
+                  const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+                  PackedVertex *packed);
+
+//--Random colors
+// rand() takes a lock on every call which shows up badly when there are
+// millions of vertices, a xorshift is plenty for picking colors
+static inline float randomColor(unsigned int &state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (float)(state >> 8) / (float)(1 << 24);
+}
+
+//String splitter
+void split(const std::string &s, std::vector<unsigned int> &elems);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include <GL/glew.h> // glew must be included before the main gl libs
+
+//--Program binary cache
+// After a program is linked from source its driver binary is saved with
+// glGetProgramBinary. The next run hands that binary straight back with
+// glProgramBinary and skips compiling and linking. The file is keyed by a
+// hash of the shader sources and of the vendor, renderer and version
+// strings, so editing a shader or changing drivers just misses the cache.
+// Drivers may still refuse a binary (after an update for example), which
+// is also just a miss.
+
+#define PROGRAM_CACHE_MAGIC "PBIN"
+#define PROGRAM_CACHE_VERSION 1
+
+//True when the driver can hand out program binaries at all
+bool programBinarySupported();
+
+//A linked program from the cache, or 0 when there is no usable binary
+GLuint loadProgramBinary(const char *cacheFileName,
+                         const char *vertexSource, const char *fragmentSource);
+
+//Call before linking a program that is going to be saved
+void requestProgramBinary(GLuint program);
+
+//Saves a linked program, failing to write it is not fatal
+bool saveProgramBinary(const char *cacheFileName, GLuint program,
+                       const char *vertexSource, const char *fragmentSource);
+
+#endif
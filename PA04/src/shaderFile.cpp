@@ -0,0 +1,30 @@
+#include "shaderFile.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <string.h>
+
+//Loads a shader from a text file
+const char* loadShaderFromFile(const char* fileName)
+{
+  std::string fileContents;
+  
+  std::ifstream in(fileName, std::ios::in | std::ios::binary);
+  if (in)
+  {
+    in.seekg(0, std::ios::end);
+    fileContents.resize(in.tellg());
+    in.seekg(0, std::ios::beg);
+    in.read(&fileContents[0], fileContents.size());
+    in.close();
+  }
+  else
+  {
+    std::cout << std::endl << "Could not open shader file: " << fileName << std::endl << std::endl;
+    throw;
+  }
+  
+  char * shader = new char[fileContents.size() + 1];// and the terminator
+  strcpy(shader, fileContents.c_str());
+  return shader;
+}
@@ -0,0 +1,9 @@
+#ifndef SHADERFILE_H
+#define SHADERFILE_H
+
+//Shader Loader
+// Reads a whole shader source file into a new[]ed, null terminated string.
+// Kept out of main.cpp so LoaderBench can time it without a GL context.
+const char* loadShaderFromFile(const char* fileName);
+
+#endif
@@ -0,0 +1,242 @@
+#include "shaderReload.h"
+#include "programCache.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <fstream>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <limits.h>
+#endif
+
+//Where a reload has got to
+enum ReloadStage
+{
+    RELOAD_IDLE,
+    RELOAD_VERTEX,// next frame compiles the vertex shader
+    RELOAD_FRAGMENT,// ... the fragment shader
+    RELOAD_LINK,// ... links
+    RELOAD_WAIT// the driver links on its own threads, poll for completion
+};
+
+static int watchFile = -1;
+static std::string shaderDirectory;
+static std::string vertexName, fragmentName;
+static std::string programCacheName;
+static ProgramSetup programSetup = NULL;
+static bool parallelCompile = false;
+
+static ReloadStage stage = RELOAD_IDLE;
+static GLuint vertexShader = 0, fragmentShader = 0, pending = 0;
+static std::string vertexSource, fragmentSource;
+
+static bool readFile(const std::string &fileName, std::string &contents)
+{
+    std::ifstream in(fileName.c_str(), std::ios::in | std::ios::binary);
+    if( !in )
+        return false;
+    contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return true;
+}
+
+static void printLog(GLuint object, bool isProgram, const char *what)
+{
+    GLint length = 0;
+    if( isProgram )
+        glGetProgramiv(object, GL_INFO_LOG_LENGTH, &length);
+    else
+        glGetShaderiv(object, GL_INFO_LOG_LENGTH, &length);
+    std::vector<char> log(length > 0 ? length : 1, '\0');
+    if( isProgram )
+        glGetProgramInfoLog(object, log.size(), NULL, &log[0]);
+    else
+        glGetShaderInfoLog(object, log.size(), NULL, &log[0]);
+    printf("WARNING: Reloaded %s failed, keeping the old program\n%s\n", what, &log[0]);
+}
+
+//Drops whatever reload is in flight
+static void abandonReload()
+{
+    if( vertexShader )
+        glDeleteShader(vertexShader);
+    if( fragmentShader )
+        glDeleteShader(fragmentShader);
+    if( pending )
+        glDeleteProgram(pending);
+    vertexShader = fragmentShader = pending = 0;
+    stage = RELOAD_IDLE;
+}
+
+static void compile(GLuint &shader, GLenum type, const std::string &source)
+{
+    const char *text = source.c_str();
+    shader = glCreateShader(type);
+    glShaderSource(shader, 1, &text, NULL);
+    glCompileShader(shader);
+}
+
+static void link()
+{
+    pending = glCreateProgram();
+    glAttachShader(pending, vertexShader);
+    glAttachShader(pending, fragmentShader);
+    if( programSetup )
+        programSetup(pending);
+    requestProgramBinary(pending);
+    glLinkProgram(pending);
+}
+
+static void startReload()
+{
+    abandonReload();
+    if( !readFile(shaderDirectory + "/" + vertexName, vertexSource) ||
+        !readFile(shaderDirectory + "/" + fragmentName, fragmentSource) )
+    {
+        //mid save most likely, the next event tries again
+        return;
+    }
+
+    stage = RELOAD_VERTEX;
+}
+
+//The finished program, or 0 if it failed to build
+static GLuint finishReload()
+{
+    GLint status = GL_FALSE;
+    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &status);
+    if( !status )
+    {
+        printLog(vertexShader, false, "vertex shader");
+        abandonReload();
+        return 0;
+    }
+    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &status);
+    if( !status )
+    {
+        printLog(fragmentShader, false, "fragment shader");
+        abandonReload();
+        return 0;
+    }
+    glGetProgramiv(pending, GL_LINK_STATUS, &status);
+    if( !status )
+    {
+        printLog(pending, true, "program");
+        abandonReload();
+        return 0;
+    }
+
+    GLuint program = pending;
+    pending = 0;
+    abandonReload();// just the shader objects now
+    saveProgramBinary(programCacheName.c_str(), program,
+                      vertexSource.c_str(), fragmentSource.c_str());
+    return program;
+}
+
+//True if a change to one of our two files is waiting
+static bool shadersChanged()
+{
+    bool changed = false;
+#ifdef __linux__
+    char buffer[16 * (sizeof(struct inotify_event) + NAME_MAX + 1)]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+    while( true )
+    {
+        ssize_t length = read(watchFile, buffer, sizeof(buffer));
+        if( length <= 0 )
+            break;
+        for( char *p = buffer; p < buffer + length; )
+        {
+            const struct inotify_event *event = (const struct inotify_event*)p;
+            if( event->len > 0 && (vertexName == event->name || fragmentName == event->name) )
+                changed = true;
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+#endif
+    return changed;
+}
+
+bool shaderWatchInit(const char *directory, const char *vertexFile,
+                     const char *fragmentFile, const char *cacheFileName,
+                     ProgramSetup setup)
+{
+    shaderWatchStop();
+    shaderDirectory = directory;
+    vertexName = vertexFile;
+    fragmentName = fragmentFile;
+    programCacheName = cacheFileName;
+    programSetup = setup;
+
+#ifdef __linux__
+    watchFile = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if( watchFile < 0 )
+        return false;
+    //editors either write in place or write a new file and rename it over
+    if( inotify_add_watch(watchFile, directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0 )
+    {
+        close(watchFile);
+        watchFile = -1;
+        return false;
+    }
+#else
+    return false;
+#endif
+
+    parallelCompile = GLEW_KHR_parallel_shader_compile;
+    if( parallelCompile )
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);// as many as the driver likes
+    return true;
+}
+
+GLuint shaderWatchPoll()
+{
+    if( watchFile < 0 )
+        return 0;
+
+    //a save while a build is in flight starts it over with the new text
+    if( shadersChanged() )
+        startReload();
+
+    switch( stage )
+    {
+    case RELOAD_VERTEX:
+        compile(vertexShader, GL_VERTEX_SHADER, vertexSource);
+        stage = RELOAD_FRAGMENT;
+        break;
+    case RELOAD_FRAGMENT:
+        compile(fragmentShader, GL_FRAGMENT_SHADER, fragmentSource);
+        stage = RELOAD_LINK;
+        break;
+    case RELOAD_LINK:
+        link();
+        if( !parallelCompile )
+            return finishReload();
+        stage = RELOAD_WAIT;
+        break;
+    case RELOAD_WAIT:
+    {
+        GLint done = GL_FALSE;
+        glGetProgramiv(pending, GL_COMPLETION_STATUS_KHR, &done);
+        if( done )
+            return finishReload();
+        break;
+    }
+    case RELOAD_IDLE:
+        break;
+    }
+    return 0;
+}
+
+void shaderWatchStop()
+{
+    abandonReload();
+#ifdef __linux__
+    if( watchFile >= 0 )
+        close(watchFile);
+#endif
+    watchFile = -1;
+}
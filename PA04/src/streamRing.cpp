@@ -0,0 +1,156 @@
+#include "streamRing.h"
+#include <string.h>
+
+//the copy target is used for creating and mapping so the vertex and
+//uniform bindings are left alone
+#define RING_TARGET GL_COPY_WRITE_BUFFER
+//regions are a multiple of this, so every region starts as aligned as any
+//uniform buffer offset needs to be
+#define RING_REGION_ALIGNMENT 256
+
+static size_t alignedSize(size_t bytes)
+{
+    return (bytes + RING_REGION_ALIGNMENT - 1) / RING_REGION_ALIGNMENT * RING_REGION_ALIGNMENT;
+}
+
+static bool createBuffer(StreamRing &ring)
+{
+    size_t total = ring.regionSize * STREAM_RING_REGIONS;
+    glGenBuffers(1, &ring.buffer);
+    glBindBuffer(RING_TARGET, ring.buffer);
+    if( ring.persistent )
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(RING_TARGET, total, NULL, flags);
+        ring.mapped = (char*)glMapBufferRange(RING_TARGET, 0, total, flags);
+    }
+    else
+    {
+        glBufferData(RING_TARGET, total, NULL, GL_STREAM_DRAW);
+        ring.mapped = NULL;
+    }
+    glBindBuffer(RING_TARGET, 0);
+    return !ring.persistent || ring.mapped != NULL;
+}
+
+static void deleteBuffer(StreamRing &ring)
+{
+    if( ring.buffer == 0 )
+        return;
+    if( ring.mapped )
+    {
+        glBindBuffer(RING_TARGET, ring.buffer);
+        glUnmapBuffer(RING_TARGET);
+        glBindBuffer(RING_TARGET, 0);
+    }
+    //GL keeps the storage alive until draws already queued are done with it
+    glDeleteBuffers(1, &ring.buffer);
+    ring.buffer = 0;
+    ring.mapped = NULL;
+    for (int r=0;r<STREAM_RING_REGIONS; r++)
+    {
+        if( ring.fences[r] )
+            glDeleteSync(ring.fences[r]);
+        ring.fences[r] = 0;
+    }
+}
+
+//A driver can list buffer storage and still refuse the persistent mapping,
+//the ring then maps each region per frame instead
+static void createRingBuffer(StreamRing &ring)
+{
+    if( createBuffer(ring) )
+        return;
+    deleteBuffer(ring);
+    ring.persistent = false;
+    createBuffer(ring);
+}
+
+bool ringInit(StreamRing &ring, size_t regionSize)
+{
+    memset(&ring, 0, sizeof(ring));
+    if( !GLEW_ARB_sync || !GLEW_VERSION_3_2 )
+        return false;
+    ring.regionSize = alignedSize(regionSize);
+    ring.region = STREAM_RING_REGIONS - 1;// the first frame moves to 0
+    ring.persistent = GLEW_ARB_buffer_storage;
+    createRingBuffer(ring);
+    return true;
+}
+
+bool ringBeginFrame(StreamRing &ring, size_t bytes)
+{
+    if( bytes > ring.regionSize )
+    {
+        //double it so a steadily growing scene does not rebuild every frame
+        size_t grown = ring.regionSize * 2;
+        ring.regionSize = alignedSize(grown > bytes ? grown : bytes);
+        deleteBuffer(ring);
+        createRingBuffer(ring);
+    }
+
+    ring.region = (ring.region + 1) % STREAM_RING_REGIONS;
+    ring.used = 0;
+    GLsync &fence = ring.fences[ring.region];
+    if( fence )
+    {
+        //normally long signaled, the GPU is only this far behind when the
+        //CPU has nothing else to do
+        GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if( result == GL_TIMEOUT_EXPIRED )
+        {
+            ring.stalls++;
+            do
+            {
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);// 1 s
+            } while( result == GL_TIMEOUT_EXPIRED );
+        }
+        glDeleteSync(fence);
+        fence = 0;
+    }
+
+    if( !ring.persistent )
+    {
+        glBindBuffer(RING_TARGET, ring.buffer);
+        ring.mapped = (char*)glMapBufferRange(RING_TARGET, ring.region * ring.regionSize, ring.regionSize,
+                                              GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+                                              GL_MAP_UNSYNCHRONIZED_BIT);
+        glBindBuffer(RING_TARGET, 0);
+    }
+    return ring.mapped != NULL;
+}
+
+size_t ringAlloc(StreamRing &ring, size_t bytes, size_t alignment, void **data)
+{
+    size_t start = (ring.used + alignment - 1) / alignment * alignment;
+    size_t regionStart = ring.region * ring.regionSize;
+    ring.used = start + bytes;
+    if( ring.persistent )
+        *data = ring.mapped + regionStart + start;
+    else
+        *data = ring.mapped + start;
+    return regionStart + start;
+}
+
+void ringFinishWrites(StreamRing &ring)
+{
+    if( !ring.persistent && ring.mapped )
+    {
+        glBindBuffer(RING_TARGET, ring.buffer);
+        glUnmapBuffer(RING_TARGET);
+        glBindBuffer(RING_TARGET, 0);
+        ring.mapped = NULL;
+    }
+}
+
+void ringEndFrame(StreamRing &ring)
+{
+    //a frame that never finished its writes still has to let go of the map
+    ringFinishWrites(ring);
+    ring.fences[ring.region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void ringCleanUp(StreamRing &ring)
+{
+    deleteBuffer(ring);
+}
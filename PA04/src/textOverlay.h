@@ -0,0 +1,30 @@
+#ifndef TEXTOVERLAY_H
+#define TEXTOVERLAY_H
+
+#include <GL/glew.h> // glew must be included before the main gl libs
+
+//--Overlay text
+// A built in 8x8 pixel font is baked into a texture atlas once. Every
+// string printed during a frame is turned into textured quads on the CPU,
+// and textDraw sends them all to the GPU in one buffer and draws them
+// with one call, with a shader of its own. No fixed function state or
+// GLUT window is needed, so it works headless and in core profiles too.
+
+#define TEXT_SMALL 1// scale of the 8 pixel font, stands in for Helvetica 12
+#define TEXT_LARGE 2// and for Helvetica 18
+
+//Bakes the atlas and builds the shader, false if GL refuses either
+bool textInit();
+
+//Queues a string, x and y are where the baseline starts in normalized
+//device coordinates (like glRasterPos2f)
+void textPrint(float x, float y, const char *text, int scale,
+               float r, float g, float b);
+
+//Draws everything queued this frame on top of what is there, in a
+//width x height pixel viewport, and empties the queue
+void textDraw(int width, int height);
+
+void textCleanUp();
+
+#endif